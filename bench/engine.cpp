@@ -0,0 +1,307 @@
+// Engine benchmarks on synthetic graphs.
+//
+// Builds graphs through NodeFactory in a few shapes and sizes, then measures
+// rendering throughput, the latency of one edit (order update and plan
+// compilation) and LoadGraph, which adds the whole patch as one batch. Prints one JSON object per line, e.g.
+//
+//   {"bench":"render","shape":"chain","nodes":256,"threads":1,...}
+//
+// so that results can be collected and compared between versions. Every
+// line also carries the SIMD kernels and SYNTH_CHECK_LEVEL of the build.
+//
+// Usage: bench_engine [--max-nodes=N] [--max-load-nodes=N] [--threads=N] [--seconds=S]
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "multigraph.h"
+#include "node_factory.h"
+#include "renderer.h"
+#include "simd/kernels.h"
+
+#include "json.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double SecondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+struct Options {
+  int max_nodes = 4096;
+  int max_load_nodes = 16384;
+  std::size_t threads = 1;
+  double seconds = 0.2;  // Minimum measured time per render case
+};
+
+// Graph under construction, every shape ends in an audio output. Nodes
+// and links are staged and added to the graph at once by Commit().
+struct Builder {
+  using Handle = std::size_t;  // Index in the batch
+
+  explicit Builder(const NodeFactory& factory) : factory(factory) { }
+
+  Handle Add(NodeType type) {
+    NodeWrapper wrapper;
+    wrapper.node = factory.CreateNode(type);
+    wrapper.attrs = std::make_shared<NodeAttributes>();
+    return batch.AddNode(wrapper);
+  }
+
+  void Link(Handle src, int out, Handle dst, int in) {
+    batch.AddLink(src, out, dst, in);
+  }
+
+  // Sums the signals pairwise until one is left.
+  Handle SumTree(std::vector<Handle> layer) {
+    while (layer.size() > 1) {
+      std::vector<Handle> next;
+      for (size_t i = 0; i + 1 < layer.size(); i += 2) {
+        Handle add = Add(NodeType::ADD);
+        Link(layer[i], 0, add, 0);
+        Link(layer[i + 1], 0, add, 1);
+        next.push_back(add);
+      }
+      if (layer.size() % 2 == 1) {
+        next.push_back(layer.back());
+      }
+      layer = std::move(next);
+    }
+    return layer[0];
+  }
+
+  void Output(Handle src) {
+    Link(src, 0, Add(NodeType::OUTPUT), 0);
+  }
+
+  void Commit(Multigraph& graph) {
+    bool added = graph.AddBatch(batch);
+    ASSERT(added);
+    batch = GraphBatch();
+  }
+
+  const NodeFactory& factory;
+  GraphBatch batch;
+};
+
+// Oscillator followed by a chain of multiplications: no parallelism at all.
+void BuildChain(Builder& b, int n) {
+  Builder::Handle prev = b.Add(NodeType::SINE_OSC);
+  for (int i = 2; i < n; ++i) {
+    Builder::Handle mul = b.Add(NodeType::MULTIPLY);
+    b.Link(prev, 0, mul, 0);
+    b.Link(prev, 0, mul, 1);
+    prev = mul;
+  }
+  b.Output(prev);
+}
+
+// One oscillator fanned out to many nodes, fanned back in by a sum tree.
+void BuildFan(Builder& b, int n) {
+  Builder::Handle osc = b.Add(NodeType::SINE_OSC);
+  std::vector<Builder::Handle> layer;
+  for (int i = 0; i < n / 2; ++i) {
+    Builder::Handle neg = b.Add(NodeType::NEGATE);
+    b.Link(osc, 0, neg, 0);
+    layer.push_back(neg);
+  }
+  b.Output(b.SumTree(layer));
+}
+
+// Many oscillators summed together.
+void BuildOscillators(Builder& b, int n) {
+  std::vector<Builder::Handle> layer;
+  for (int i = 0; i < n / 2; ++i) {
+    layer.push_back(b.Add(i % 2 ? NodeType::SINE_OSC : NodeType::SQUARE_OSC));
+  }
+  b.Output(b.SumTree(layer));
+}
+
+// Deep arithmetic: oscillator pairs mixed, clamped and multiplied in a tree.
+void BuildArithmeticTree(Builder& b, int n) {
+  std::vector<Builder::Handle> layer;
+  for (int i = 0; i < n / 4; ++i) {
+    Builder::Handle osc = b.Add(NodeType::SINE_OSC);
+    Builder::Handle clamp = b.Add(NodeType::CLAMP);
+    b.Link(osc, 0, clamp, 0);
+    layer.push_back(clamp);
+  }
+
+  while (layer.size() > 1) {
+    std::vector<Builder::Handle> next;
+    for (size_t i = 0; i + 1 < layer.size(); i += 2) {
+      Builder::Handle node = b.Add(next.size() % 2 ? NodeType::MULTIPLY : NodeType::MIX);
+      b.Link(layer[i], 0, node, 0);
+      b.Link(layer[i + 1], 0, node, 1);
+      next.push_back(node);
+    }
+    if (layer.size() % 2 == 1) {
+      next.push_back(layer.back());
+    }
+    layer = std::move(next);
+  }
+  b.Output(layer[0]);
+}
+
+struct Shape {
+  const char* name;
+  std::function<void(Builder&, int)> build;
+};
+
+const std::vector<Shape> kShapes = {
+  {"chain", BuildChain},
+  {"fan", BuildFan},
+  {"oscillators", BuildOscillators},
+  {"arithmetic_tree", BuildArithmeticTree},
+};
+
+void Emit(nlohmann::json j) {
+  j["simd"] = GetBlockKernels().name;
+  j["check_level"] = kCheckLevel;
+  std::cout << j.dump() << std::endl;
+}
+
+void BenchRender(const Shape& shape, int n, const Options& options) {
+  auto graph = std::make_shared<Multigraph>();
+  Renderer renderer(graph, options.threads);
+  NodeFactory factory(Context{renderer.GetOutput()});
+  Builder builder(factory);
+  shape.build(builder, n);
+  builder.Commit(*graph);
+
+  std::size_t num_nodes = graph->GetNodes().size();
+  std::size_t num_kernels = 0;
+  std::size_t num_levels = 0;
+  {
+    auto plan = graph->AcquirePlan();
+    num_kernels = plan->NumKernels();
+    num_levels = plan->NumLevels();
+  }
+
+  const std::size_t frames = kSampleRate;
+  std::vector<float> out(frames * kNumChannels);
+  renderer.Render(out.data(), frames);  // Warm up
+
+  std::uint64_t samples = 0;
+  auto start = Clock::now();
+  double elapsed = 0.0;
+  while (elapsed < options.seconds) {
+    renderer.Render(out.data(), frames);
+    samples += frames;
+    elapsed = SecondsSince(start);
+  }
+
+  Emit({
+    {"bench", "render"},
+    {"shape", shape.name},
+    {"nodes", num_nodes},
+    {"kernels", num_kernels},
+    {"levels", num_levels},
+    {"threads", renderer.NumThreads()},
+    {"samples_per_sec", samples / elapsed},
+    {"realtime_factor", samples / elapsed / kSampleRate},
+    {"ns_per_node_sample", elapsed * 1e9 / (static_cast<double>(samples) * num_nodes)},
+  });
+}
+
+void BenchEdit(const Shape& shape, int n) {
+  auto output = std::make_shared<AudioOutput>();
+  NodeFactory factory(Context{output});
+  Multigraph graph;
+  Builder builder(factory);
+  shape.build(builder, n);
+  builder.Commit(graph);
+
+  // One node added and linked into the output's input, then removed:
+  // three plan compilations.
+  const int num_edits = 5;
+  node_id_t output_id;
+  for (auto& [id, wrapper] : graph.GetNodes()) {
+    if (wrapper.node->GetType() == NodeType::OUTPUT) {
+      output_id = id;
+    }
+  }
+  auto output_link = graph.GetLinks().GetNodeLinks(output_id).front();
+  auto link_pins = graph.GetLinks().link_id_to_pins.Get(output_link);
+  node_id_t src = graph.GetPins().GetNodeFromPin(link_pins.first);
+
+  auto start = Clock::now();
+  for (int i = 0; i < num_edits; ++i) {
+    node_id_t neg = graph.AddNode({factory.CreateNode(NodeType::NEGATE), std::make_shared<NodeAttributes>()});
+    link_id_t link_id;
+    bool added = graph.AddLink(src, 0, neg, 0, &link_id, true);
+    ASSERT(added);
+    graph.RemoveNode(neg);
+  }
+  double elapsed = SecondsSince(start);
+
+  Emit({
+    {"bench", "edit"},
+    {"shape", shape.name},
+    {"nodes", graph.GetNodes().size()},
+    {"edit_us", elapsed * 1e6 / (3 * num_edits)},
+  });
+}
+
+void BenchLoad(const Shape& shape, int n) {
+  auto output = std::make_shared<AudioOutput>();
+  NodeFactory factory(Context{output});
+  Multigraph source;
+  Builder builder(factory);
+  shape.build(builder, n);
+  builder.Commit(source);
+
+  auto j = nlohmann::json::object();
+  SaveGraph(source, j);
+
+  Multigraph graph;
+  auto start = Clock::now();
+  LoadGraph(graph, j, factory);
+  double elapsed = SecondsSince(start);
+
+  Emit({
+    {"bench", "load"},
+    {"shape", shape.name},
+    {"nodes", graph.GetNodes().size()},
+    {"links", graph.GetLinks().link_id_to_pins.size()},
+    {"load_ms", elapsed * 1e3},
+  });
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg.starts_with("--max-nodes=")) {
+      options.max_nodes = std::stoi(arg.substr(12));
+    } else if (arg.starts_with("--max-load-nodes=")) {
+      options.max_load_nodes = std::stoi(arg.substr(17));
+    } else if (arg.starts_with("--threads=")) {
+      options.threads = std::max(1, std::stoi(arg.substr(10)));
+    } else if (arg.starts_with("--seconds=")) {
+      options.seconds = std::stod(arg.substr(10));
+    } else {
+      std::cerr << "Unknown argument: " << arg << std::endl;
+      return 1;
+    }
+  }
+
+  for (const auto& shape : kShapes) {
+    for (int n = 16; n <= options.max_nodes; n *= 4) {
+      BenchRender(shape, n, options);
+      BenchEdit(shape, n);
+    }
+    for (int n = 16; n <= options.max_load_nodes; n *= 4) {
+      BenchLoad(shape, n);
+    }
+  }
+  return 0;
+}
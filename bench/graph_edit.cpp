@@ -0,0 +1,216 @@
+// Edit latency vs graph size.
+//
+// Compares the incremental topological order with the full sort it replaced,
+// on the same random edits, then measures a whole Multigraph::AddLink
+// including the plan compilation.
+//
+// Usage: bench_graph_edit [max_nodes]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <set>
+#include <stack>
+#include <string>
+#include <vector>
+
+#include "multigraph.h"
+#include "node_factory.h"
+#include "topological_order.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double MicrosSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+// The DFS order Multigraph used to rebuild after every edit,
+// including the map and edge sets it built first. Fixed to visit once.
+std::vector<int> FullSort(const std::vector<std::pair<int, int>>& edge_list, int num_vertices) {
+  std::map<int, int> index;
+  for (int i = 0; i < num_vertices; ++i) {
+    index[i] = i;
+  }
+
+  std::vector<std::set<int>> edges(num_vertices);
+  for (auto [from, to] : edge_list) {
+    edges[index[from]].insert(index[to]);
+  }
+
+  std::vector<std::uint8_t> visited(num_vertices, 0);
+  std::stack<std::pair<int, bool>> stack;
+  std::vector<int> order;
+  order.reserve(num_vertices);
+  for (int i = 0; i < num_vertices; ++i) {
+    if (visited[i]) {
+      continue;
+    }
+
+    stack.push({i, false});
+    while (!stack.empty()) {
+      auto [v, done] = stack.top();
+      stack.pop();
+      if (done) {
+        order.push_back(v);
+        continue;
+      }
+
+      // The original pushed vertices reachable along two paths twice,
+      // emitting one of them twice and dropping another.
+      if (visited[v]) {
+        continue;
+      }
+
+      visited[v] = true;
+      stack.push({v, true});
+      for (int w : edges[v]) {
+        if (!visited[w]) {
+          stack.push({w, false});
+        }
+      }
+    }
+  }
+
+  std::reverse(order.begin(), order.end());
+  return order;
+}
+
+// Random DAG with about 2 edges per vertex. Vertices are inserted in a
+// shuffled order, so most edges disagree with the initial positions.
+struct RandomEdits {
+  RandomEdits(int num_vertices, std::mt19937& rng) : rank(num_vertices) {
+    for (int i = 0; i < num_vertices; ++i) {
+      rank[i] = i;
+    }
+    std::shuffle(rank.begin(), rank.end(), rng);
+
+    std::uniform_int_distribution<int> pick(0, num_vertices - 1);
+    while (edges.size() < 2 * static_cast<std::size_t>(num_vertices)) {
+      int a = pick(rng);
+      int b = pick(rng);
+      if (a == b) {
+        continue;
+      }
+      // Edges always go up in rank, which keeps the graph acyclic.
+      edges.push_back(rank[a] < rank[b] ? std::make_pair(a, b) : std::make_pair(b, a));
+    }
+  }
+
+  std::vector<int> rank;
+  std::vector<std::pair<int, int>> edges;
+};
+
+void BenchOrder(int num_vertices, std::mt19937& rng) {
+  RandomEdits edits(num_vertices, rng);
+  const std::size_t num_timed = std::min<std::size_t>(200, edits.edges.size() / 4);
+  const std::size_t num_built = edits.edges.size() - num_timed;
+
+  TopologicalOrder order;
+  for (int v = 0; v < num_vertices; ++v) {
+    order.AddVertex(v);
+  }
+  for (std::size_t i = 0; i < num_built; ++i) {
+    order.AddEdge(edits.edges[i].first, edits.edges[i].second);
+  }
+
+  // Timed: add the remaining edges one by one.
+  double incremental_us = 0.0;
+  std::size_t affected = 0;
+  for (std::size_t i = num_built; i < edits.edges.size(); ++i) {
+    auto start = Clock::now();
+    order.AddEdge(edits.edges[i].first, edits.edges[i].second);
+    incremental_us += MicrosSince(start);
+    affected += order.LastAffected();
+  }
+
+  double full_us = 0.0;
+  std::vector<std::pair<int, int>> edge_list(edits.edges.begin(), edits.edges.begin() + num_built);
+  for (std::size_t i = num_built; i < edits.edges.size(); ++i) {
+    edge_list.push_back(edits.edges[i]);
+    auto start = Clock::now();
+    auto sorted = FullSort(edge_list, num_vertices);
+    full_us += MicrosSince(start);
+    ASSERT_EQUAL(sorted.size(), static_cast<std::size_t>(num_vertices));
+  }
+
+  printf("%8d %12.2f %12.2f %10.1f %12.1f\n", num_vertices,
+    incremental_us / num_timed, full_us / num_timed,
+    full_us / incremental_us, static_cast<double>(affected) / num_timed);
+}
+
+void BenchMultigraph(int num_nodes, std::mt19937& rng) {
+  NodeFactory factory(Context{std::make_shared<AudioOutput>()});
+  Multigraph graph;
+
+  // Chains of additions feeding one output, the rest of the inputs free.
+  std::vector<node_id_t> ids;
+  for (int i = 0; i < num_nodes; ++i) {
+    NodeWrapper wrapper;
+    wrapper.node = factory.CreateNode(NodeType::ADD);
+    wrapper.attrs = std::make_shared<NodeAttributes>();
+    ids.push_back(graph.AddNode(wrapper));
+  }
+
+  NodeWrapper output;
+  output.node = factory.CreateNode(NodeType::OUTPUT);
+  output.attrs = std::make_shared<NodeAttributes>();
+  node_id_t output_id = graph.AddNode(output);
+
+  link_id_t link_id;
+  for (int i = 0; i + 1 < num_nodes; ++i) {
+    graph.AddLink(ids[i], 0, ids[i + 1], 0, &link_id, true);
+  }
+  graph.AddLink(ids.back(), 0, output_id, 0, &link_id, true);
+
+  const int num_edits = 100;
+  std::uniform_int_distribution<int> pick(0, num_nodes - 1);
+  double add_us = 0.0;
+  double remove_us = 0.0;
+  int done = 0;
+  while (done < num_edits) {
+    int a = pick(rng);
+    int b = pick(rng);
+    if (a >= b) {
+      continue;
+    }
+
+    // Second input of a later node in the chain, always acyclic.
+    auto start = Clock::now();
+    bool added = graph.AddLink(ids[a], 0, ids[b], 1, &link_id, true);
+    add_us += MicrosSince(start);
+    if (!added) {
+      continue;
+    }
+
+    start = Clock::now();
+    graph.RemoveLink(link_id);
+    remove_us += MicrosSince(start);
+    ++done;
+  }
+
+  printf("%8d %12.1f %12.1f\n", num_nodes, add_us / num_edits, remove_us / num_edits);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int max_nodes = argc > 1 ? std::stoi(argv[1]) : 100000;
+  std::mt19937 rng(42);
+
+  printf("Topological order, average per added edge\n");
+  printf("%8s %12s %12s %10s %12s\n", "nodes", "incr_us", "full_us", "speedup", "affected");
+  for (int n = 100; n <= max_nodes; n *= 10) {
+    BenchOrder(n, rng);
+  }
+
+  printf("\nMultigraph edit including plan compilation, average per edit\n");
+  printf("%8s %12s %12s\n", "nodes", "add_us", "remove_us");
+  for (int n = 100; n <= std::min(max_nodes, 10000); n *= 10) {
+    BenchMultigraph(n, rng);
+  }
+  return 0;
+}
@@ -0,0 +1,124 @@
+// Patch loading, JSON vs binary.
+//
+// Generates layered patches of oscillators and arithmetic, saves each in
+// both formats, then times reading one back into an empty graph: file to
+// memory (read and parse the JSON, or mmap and check the binary), then
+// building the graph from it. Also shows the memory the patch takes per
+// node, see GetPatchMemory().
+//
+// Usage: bench_patch_load [max_nodes]
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "multigraph.h"
+#include "node_factory.h"
+#include "patch_file.h"
+
+#include "json.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double MillisSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Layers of nodes, each input linked to some node of the layer above.
+void BuildPatch(Multigraph& graph, const NodeFactory& factory, int num_nodes) {
+  const NodeType sources[] = {NodeType::SINE_OSC, NodeType::SQUARE_OSC, NodeType::CONSTANT};
+  const NodeType ops[] = {NodeType::ADD, NodeType::MULTIPLY, NodeType::MIX, NodeType::NEGATE, NodeType::CLAMP};
+  const int layer_size = 64;
+  std::mt19937 rng(42);
+
+  GraphBatch batch;
+  std::vector<std::size_t> above;
+  for (int i = 0; i < num_nodes; ++i) {
+    if (i > 0 && i % layer_size == 0) {
+      above.clear();
+      for (std::size_t j = i - layer_size; j < static_cast<std::size_t>(i); ++j) {
+        above.push_back(j);
+      }
+    }
+
+    NodeType type = above.empty() ? sources[rng() % 3] : ops[rng() % 5];
+    auto node = factory.CreateNode(type);
+    auto attrs = std::make_shared<NodeAttributes>();
+    attrs->pos_x = static_cast<float>(i % layer_size) * 200;
+    attrs->pos_y = static_cast<float>(i / layer_size) * 150;
+    std::size_t idx = batch.AddNode({node, attrs});
+    for (std::size_t in = 0; in < node->NumInputs() && !above.empty(); ++in) {
+      batch.AddLink(above[rng() % above.size()], 0, idx, static_cast<int>(in));
+    }
+  }
+  bool added = graph.AddBatch(batch);
+  ASSERT(added);
+}
+
+void Bench(int num_nodes, const std::filesystem::path& dir) {
+  auto output = std::make_shared<AudioOutput>();
+  NodeFactory factory(Context{output});
+
+  Multigraph source;
+  BuildPatch(source, factory, num_nodes);
+  const auto json_path = (dir / "bench_patch.json").string();
+  const auto binary_path = (dir / ("bench_patch" + std::string(kPatchExtension))).string();
+  bool saved = SavePatchFile(source, json_path) && SavePatchFile(source, binary_path);
+  ASSERT(saved);
+
+  double json_parse_ms = 0;
+  double json_total_ms = 0;
+  {
+    Multigraph graph;
+    auto start = Clock::now();
+    std::ifstream f(json_path);
+    nlohmann::json j;
+    f >> j;
+    json_parse_ms = MillisSince(start);
+    bool loaded = LoadGraph(graph, j, factory);
+    json_total_ms = MillisSince(start);
+    ASSERT(loaded);
+  }
+
+  double binary_map_ms = 0;
+  double binary_total_ms = 0;
+  {
+    Multigraph graph;
+    auto start = Clock::now();
+    MappedFile file;
+    PatchView patch;
+    bool opened = file.Open(binary_path) && patch.Open(file.GetData(), file.GetSize());
+    binary_map_ms = MillisSince(start);
+    bool loaded = opened && LoadPatch(graph, patch, factory);
+    binary_total_ms = MillisSince(start);
+    ASSERT(loaded);
+  }
+
+  printf("%8d %8zu %8zu %10.1f %10.1f %10.2f %10.2f %12.2f %12.2f %8.1fx\n",
+         num_nodes, source.GetLinks().link_id_to_pins.size(), GetPatchMemory(source).BytesPerNode(),
+         std::filesystem::file_size(json_path) / 1024.0, std::filesystem::file_size(binary_path) / 1024.0,
+         json_parse_ms, json_total_ms, binary_map_ms, binary_total_ms, json_total_ms / binary_total_ms);
+
+  std::filesystem::remove(json_path);
+  std::filesystem::remove(binary_path);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int max_nodes = argc > 1 ? std::stoi(argv[1]) : 16384;
+  auto dir = std::filesystem::temp_directory_path();
+
+  printf("%8s %8s %8s %10s %10s %10s %10s %12s %12s %9s\n", "nodes", "links", "b/node", "json_kb", "synp_kb",
+         "parse_ms", "json_ms", "map_ms", "synp_ms", "speedup");
+  for (int n = 1024; n <= max_nodes; n *= 4) {
+    Bench(n, dir);
+  }
+  return 0;
+}
@@ -0,0 +1,220 @@
+// RingBuffer throughput and latency, against the version it replaced.
+//
+// Throughput: a producer and a consumer thread stream samples in fixed
+// chunks, the consumer checks that it sees them in order. The new ring is
+// measured copying from a vector like the old one, and writing in place
+// through Reserve/Commit like SampleWriter does.
+//
+// Latency: two rings and two threads bounce one sample back and forth.
+//
+// Usage: bench_ring_buffer [million_samples]
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ring_buffer.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Sample = float;  // As in SampleBuffer
+
+// SampleBuffer of 4000 stereo frames, main's default, rounded up to a
+// power of two like RingBuffer does.
+const std::size_t kRingSize = 8192;
+
+// Stays exact in a float however many samples go through.
+Sample SampleAt(std::uint64_t i) {
+  return static_cast<Sample>(i & 0xffff);
+}
+
+double SecondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// The ring SampleWriter used before: arbitrary size with % on every
+// operation, both positions on one cache line, seq_cst everywhere.
+template <typename T>
+class LegacyRingBuffer {
+ public:
+  explicit LegacyRingBuffer(std::size_t size)
+      : size_(size), data_(size) {
+    read_position_.store(0);
+    write_position_.store(0);
+  }
+
+  void Write(const std::vector<T>& src, std::size_t n) {
+    auto head = write_position_.load();
+    auto position = head % size_;
+
+    if (n > size_ - position) {
+      std::size_t part_size = size_ - position;
+      std::copy(src.begin(), src.begin() + part_size, data_.begin() + position);
+      std::copy(src.begin() + part_size, src.begin() + n, data_.begin());
+    } else {
+      std::copy(src.begin(), src.begin() + n, data_.begin() + position);
+    }
+
+    write_position_.store(head + n);
+  }
+
+  void Read(T* dst, std::size_t n) {
+    std::span<T> sp(dst, n);
+    auto head = read_position_.load();
+    auto position = head % size_;
+    if (n > size_ - position) {
+      std::copy(data_.begin() + position, data_.end(), sp.begin());
+      std::size_t num_copied = size_ - position;
+      std::size_t remaining = n - num_copied;
+      std::copy(data_.begin(), data_.begin() + remaining, sp.begin() + num_copied);
+    } else {
+      std::copy(data_.begin() + position, data_.begin() + position + n, sp.begin());
+    }
+
+    read_position_.store(head + n);
+  }
+
+  std::size_t ReadyToRead() const {
+    return write_position_.load() - read_position_.load();
+  }
+
+  std::size_t ReadyToWrite() const {
+    std::size_t delta = write_position_.load() - read_position_.load();
+    assert(delta <= size_);
+    return size_ - delta;
+  }
+
+ private:
+  const std::size_t size_;
+  std::vector<T> data_;
+  std::atomic<std::uint64_t> read_position_;
+  std::atomic<std::uint64_t> write_position_;
+};
+
+enum class WriteMode { kCopy, kInPlace };
+
+template <typename Ring>
+void Produce(Ring& ring, std::uint64_t total, std::size_t chunk, WriteMode mode) {
+  std::vector<Sample> staging(chunk);
+  std::uint64_t value = 0;
+  for (std::uint64_t done = 0; done < total; done += chunk) {
+    while (ring.ReadyToWrite() < chunk) {
+      std::this_thread::yield();
+    }
+
+    if constexpr (requires { ring.Reserve(chunk); }) {
+      if (mode == WriteMode::kInPlace) {
+        for (std::size_t written = 0; written < chunk;) {
+          auto space = ring.Reserve(chunk - written);
+          for (auto& sample : space) {
+            sample = SampleAt(value++);
+          }
+          ring.Commit(space.size());
+          written += space.size();
+        }
+        continue;
+      }
+    }
+
+    for (auto& sample : staging) {
+      sample = SampleAt(value++);
+    }
+    ring.Write(staging, chunk);
+  }
+}
+
+// Returns false if samples came out of order.
+template <typename Ring>
+bool Consume(Ring& ring, std::uint64_t total, std::size_t chunk) {
+  std::vector<Sample> out(chunk);
+  std::uint64_t value = 0;
+  bool ok = true;
+  for (std::uint64_t done = 0; done < total; done += chunk) {
+    while (ring.ReadyToRead() < chunk) {
+      std::this_thread::yield();
+    }
+    ring.Read(out.data(), chunk);
+    for (auto sample : out) {
+      ok &= sample == SampleAt(value++);
+    }
+  }
+  return ok;
+}
+
+template <typename Ring>
+void BenchThroughput(const char* name, std::uint64_t total, std::size_t chunk, WriteMode mode) {
+  Ring ring(kRingSize);
+  total -= total % chunk;
+
+  bool ok = false;
+  auto start = Clock::now();
+  std::thread consumer([&] { ok = Consume(ring, total, chunk); });
+  Produce(ring, total, chunk, mode);
+  consumer.join();
+  double elapsed = SecondsSince(start);
+
+  printf("%-18s %8zu %14.1f %10.2f %6s\n", name, chunk,
+         total / elapsed / 1e6, elapsed * 1e9 / total, ok ? "ok" : "FAIL");
+}
+
+template <typename Ring>
+void BenchLatency(const char* name, int round_trips) {
+  Ring ping(kRingSize);
+  Ring pong(kRingSize);
+  std::vector<Sample> staging(1);
+
+  std::thread echo([&] {
+    std::vector<Sample> reply(1);
+    for (int i = 0; i < round_trips; ++i) {
+      while (ping.ReadyToRead() == 0) {
+        std::this_thread::yield();
+      }
+      ping.Read(reply.data(), 1);
+      pong.Write(reply, 1);
+    }
+  });
+
+  auto start = Clock::now();
+  Sample sample = 0;
+  for (int i = 0; i < round_trips; ++i) {
+    staging[0] = SampleAt(i);
+    ping.Write(staging, 1);
+    while (pong.ReadyToRead() == 0) {
+      std::this_thread::yield();
+    }
+    pong.Read(&sample, 1);
+  }
+  double elapsed = SecondsSince(start);
+  echo.join();
+
+  printf("%-18s %14.1f\n", name, elapsed * 1e9 / round_trips);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::uint64_t total = (argc > 1 ? std::stoull(argv[1]) : 200) * 1000000;
+
+  printf("Throughput, %llu samples through a %zu sample ring\n",
+         static_cast<unsigned long long>(total), kRingSize);
+  printf("%-18s %8s %14s %10s %6s\n", "ring", "chunk", "Msamples/s", "ns/sample", "order");
+  for (std::size_t chunk : {64, 512, 2048}) {
+    BenchThroughput<LegacyRingBuffer<Sample>>("legacy", total, chunk, WriteMode::kCopy);
+    BenchThroughput<RingBuffer<Sample>>("new copy", total, chunk, WriteMode::kCopy);
+    BenchThroughput<RingBuffer<Sample>>("new reserve", total, chunk, WriteMode::kInPlace);
+  }
+
+  const int round_trips = 100000;
+  printf("\nLatency, one sample there and back, average of %d\n", round_trips);
+  printf("%-18s %14s\n", "ring", "round_trip_ns");
+  BenchLatency<LegacyRingBuffer<Sample>>("legacy", round_trips);
+  BenchLatency<RingBuffer<Sample>>("new", round_trips);
+  return 0;
+}
@@ -0,0 +1,79 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <bit>
+#include <new>
+
+thread_local NodeArena::Scope* NodeArena::current_scope = nullptr;
+
+NodeArena::Scope::Scope(NodeArena* arena) : arena(arena), outer(current_scope) {
+  current_scope = this;
+}
+
+NodeArena::Scope::~Scope() {
+  current_scope = outer;
+}
+
+std::pmr::memory_resource* NodeArena::Current() {
+  return current_scope ? current_scope->arena : std::pmr::new_delete_resource();
+}
+
+NodeArena::Stats NodeArena::GetStats() const {
+  std::lock_guard lock(mtx);
+  return stats;
+}
+
+std::size_t NodeArena::ClassOf(std::size_t bytes) {
+  return std::countr_zero(std::bit_ceil(std::max(bytes, kMinBlockSize))) - std::countr_zero(kMinBlockSize);
+}
+
+void* NodeArena::do_allocate(std::size_t bytes, std::size_t alignment) {
+  bool pooled = bytes <= kMaxBlockSize && alignment <= kMinBlockSize;
+  std::size_t size = pooled ? std::bit_ceil(std::max(bytes, kMinBlockSize)) : bytes;
+  if (current_scope && current_scope->arena == this) {
+    current_scope->bytes += size;
+  }
+
+  std::lock_guard lock(mtx);
+  stats.in_use += size;
+  ++stats.num_blocks;
+  if (!pooled) {
+    stats.reserved += size;
+    return ::operator new(bytes, std::align_val_t{alignment});
+  }
+
+  auto& head = free_lists[ClassOf(size)];
+  if (head) {
+    void* block = head;
+    head = *static_cast<void**>(block);
+    return block;
+  }
+
+  // Chunks start at kMinBlockSize alignment and blocks are multiples of it.
+  if (chunk_used + size > kChunkSize) {
+    chunks.push_back(std::make_unique<std::byte[]>(kChunkSize));
+    chunk_used = 0;
+    stats.reserved += kChunkSize;
+  }
+  void* block = chunks.back().get() + chunk_used;
+  chunk_used += size;
+  return block;
+}
+
+void NodeArena::do_deallocate(void* p, std::size_t bytes, std::size_t alignment) {
+  bool pooled = bytes <= kMaxBlockSize && alignment <= kMinBlockSize;
+  std::size_t size = pooled ? std::bit_ceil(std::max(bytes, kMinBlockSize)) : bytes;
+
+  std::lock_guard lock(mtx);
+  stats.in_use -= size;
+  --stats.num_blocks;
+  if (!pooled) {
+    stats.reserved -= size;
+    ::operator delete(p, std::align_val_t{alignment});
+    return;
+  }
+
+  auto& head = free_lists[ClassOf(size)];
+  *static_cast<void**>(p) = head;
+  head = p;
+}
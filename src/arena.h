@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+// Pool the nodes of a patch and their pins are allocated from. Blocks are
+// carved from large chunks in power of two size classes and recycled
+// through per class free lists, so a node, its pins and its state sit in
+// a few neighbouring cache lines instead of all over the heap. Requests
+// above the largest class or over-aligned ones go to the heap.
+//
+// Locked, meant for graph edits: the audio thread never allocates nodes
+// and never frees them (retired plans are collected on the GUI thread).
+class NodeArena : public std::pmr::memory_resource, public std::enable_shared_from_this<NodeArena> {
+ public:
+  struct Stats {
+    std::size_t reserved = 0;  // Chunks and large blocks taken from the heap
+    std::size_t in_use = 0;  // Bytes in live blocks, rounded up to their class
+    std::size_t num_blocks = 0;  // Live blocks
+  };
+
+  NodeArena() = default;
+
+  NodeArena(const NodeArena&) = delete;
+  NodeArena& operator= (const NodeArena&) = delete;
+
+  // Constructs a node in the arena, control block included. Whatever its
+  // constructor allocates from Current() lands here too and is counted
+  // in GetMemoryUsage() of the node. The arena has to be owned by a
+  // shared_ptr, every node keeps it alive.
+  template <typename T, typename... Args>
+  std::shared_ptr<T> Make(Args&&... args);
+
+  Stats GetStats() const;
+
+  // Arena of the Make() running on this thread, the heap outside of one.
+  static std::pmr::memory_resource* Current();
+
+ protected:
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+  void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override;
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+ private:
+  // Allocator for std::allocate_shared, shares ownership of the arena.
+  template <typename T>
+  struct Allocator {
+    using value_type = T;
+
+    Allocator(std::shared_ptr<NodeArena> arena) : arena(std::move(arena)) { }
+    template <typename U>
+    Allocator(const Allocator<U>& other) : arena(other.arena) { }
+
+    T* allocate(std::size_t n) {
+      return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) {
+      arena->deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    template <typename U>
+    bool operator== (const Allocator<U>& other) const {
+      return arena == other.arena;
+    }
+
+    std::shared_ptr<NodeArena> arena;
+  };
+
+  // Makes this the Current() arena of the thread while in scope and
+  // counts the bytes allocated meanwhile.
+  struct Scope {
+    explicit Scope(NodeArena* arena);
+    ~Scope();
+
+    NodeArena* arena;
+    Scope* outer;
+    std::size_t bytes = 0;
+  };
+
+  static constexpr std::size_t kMinBlockSize = 16;
+  static constexpr std::size_t kMaxBlockSize = 4096;
+  static constexpr std::size_t kNumClasses = 9;  // 16 to 4096
+  static constexpr std::size_t kChunkSize = 64 * 1024;
+
+  static std::size_t ClassOf(std::size_t bytes);
+
+  static thread_local Scope* current_scope;
+
+  mutable std::mutex mtx;
+  void* free_lists[kNumClasses] = {};  // Intrusive, next block in the first bytes
+  std::vector<std::unique_ptr<std::byte[]>> chunks;
+  std::size_t chunk_used = kChunkSize;  // Of the last chunk
+  Stats stats;
+};
+
+template <typename T, typename... Args>
+std::shared_ptr<T> NodeArena::Make(Args&&... args) {
+  Scope scope(this);
+  auto node = std::allocate_shared<T>(Allocator<T>(shared_from_this()), std::forward<Args>(args)...);
+  node->memory_usage = scope.bytes;
+  return node;
+}
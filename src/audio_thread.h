@@ -9,20 +9,29 @@
 #include <algorithm>
 #include <thread>
 
+#include "backend.h"
 #include "output.h"
 #include "multigraph.h"
+#include "renderer.h"
 
 
+enum class RenderMode {
+  kPush,  // A producer thread keeps the backend's ring buffer full
+  kPull   // The backend renders each period in its callback, no ring latency
+};
+
 // Spins and provides data for audio backend
-class AudioThread {
+class AudioThread : public SampleSource {
  public:
   AudioThread(
-    std::shared_ptr<RtAudioOutputHandler> rt_out,
-    std::shared_ptr<Multigraph> graph)
-      : graph(graph)
-      , rt_out(rt_out)
-      , writer(rt_out->GetBuffer())
-      , output(std::make_shared<AudioOutput>()) {
+    std::shared_ptr<OutputBackend> backend,
+    std::shared_ptr<Multigraph> graph,
+    std::size_t num_threads = 1,
+    RenderMode mode = RenderMode::kPush)
+      : backend(backend)
+      , writer(backend->GetBuffer())
+      , renderer(graph, num_threads)
+      , mode(mode) {
   }
 
   ~AudioThread() {
@@ -30,8 +39,15 @@ class AudioThread {
   }
 
   void Start() {
-    rt_out->Start();
     running_ = true;
+    if (mode == RenderMode::kPull) {
+      backend->SetSource(this);
+      backend->Start();
+      std::cout << "Audio rendering in the backend callback." << std::endl;
+      return;
+    }
+
+    backend->Start();
     thread_ = std::thread(&AudioThread::Spin, this);
     std::cout << "Audio thread started." << std::endl;
   }
@@ -43,7 +59,13 @@ class AudioThread {
     }
     std::cout << "Audio thread stopped." << std::endl;
     
-    rt_out->Stop();
+    backend->Stop();
+    backend->SetSource(nullptr);
+  }
+
+  // Pull mode: one period, straight from the graph.
+  void Render(float* out, std::size_t n) override {
+    renderer.Render(out, n);
   }
   
   void PlayPause() {
@@ -57,20 +79,42 @@ class AudioThread {
   bool IsPlaying() const {
     return running_;
   }
+
+  RenderMode GetMode() const {
+    return mode;
+  }
   
+  const auto& GetBackend() const {
+    return backend;
+  }
+
   auto GetOutput() {
-    return output;
+    return renderer.GetOutput();
   }
   
   float GetTimestamp() {
-    return writer.GetTimestamp();
+    return renderer.GetTimestamp();
+  }
+
+  // Sample position rendered so far. Safe to call from any thread.
+  std::uint64_t GetPosition() const {
+    return renderer.GetPosition();
+  }
+
+  std::size_t NumThreads() const {
+    return renderer.NumThreads();
+  }
+
+  // Time spent rendering. Safe to call from any thread.
+  const CycleCounter& GetRenderProfile() const {
+    return renderer.GetProfile();
   }
 
  private:
   void Spin() {
     while (running_) {
       size_t ready_to_write = 0;
-      while (running_ && !(ready_to_write = writer.ReadyToWrite())) {
+      while (running_ && (ready_to_write = writer.ReadyToWrite()) < kNumChannels) {
         // Busy wait until data is consumed.
         std::this_thread::yield();
         continue;
@@ -80,30 +124,25 @@ class AudioThread {
         break;
       }
 
-      {
-      // Graph mutex locked
-      auto access = graph->GetAccess();
-      auto nodes = access->GetSortedNodes();
-
-      for (size_t i = 0; i < ready_to_write; ++i) {
-        float timestamp = writer.GetTimestamp();
-        for (auto node : nodes) {
-          node->Process(timestamp);
-        }
-        
-        writer.Write(output->wave);
-      }
-
+      size_t frames = ready_to_write / kNumChannels;
+      std::uint64_t start = ReadCycles();
+      // Renders straight into the ring, in two parts where it wraps.
+      for (size_t left = frames; left > 0;) {
+        auto space = writer.Reserve(left * kNumChannels);
+        size_t count = space.size() / kNumChannels;
+        HOT_ASSERT(count > 0);
+        renderer.Render(space.data(), count);
+        writer.Commit(count * kNumChannels);
+        left -= count;
       }
-      
-      writer.Flush();
+      backend->GetTelemetry().RecordRender(frames, ReadCycles() - start);
     }
   }
 
-  std::shared_ptr<Multigraph> graph;
-  std::shared_ptr<RtAudioOutputHandler> rt_out;
+  std::shared_ptr<OutputBackend> backend;
   SampleWriter writer;
-  std::shared_ptr<AudioOutput> output;
+  Renderer renderer;
+  const RenderMode mode;
 
   std::thread thread_;
   bool running_ = false;
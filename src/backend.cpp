@@ -0,0 +1,129 @@
+#include "backend.h"
+
+std::size_t OutputBackend::Pull(void* out, std::size_t n) {
+  // Ring level as the device finds it, nothing to report in pull mode.
+  std::size_t fill = 0;
+  if (!source.load(std::memory_order_acquire)) {
+    fill = buf->ReadyToRead() / kNumChannels;
+  }
+
+  std::size_t valid = 0;
+  std::size_t sample_size = 0;
+  if (format == SampleFormat::kFloat32) {
+    valid = PullFloat(static_cast<float*>(out), n);
+    sample_size = sizeof(float);
+  } else {
+    valid = PullInt16(static_cast<SampleType*>(out), n);
+    sample_size = sizeof(SampleType);
+  }
+
+  // Both formats have all zero bits for silence.
+  auto* bytes = static_cast<char*>(out);
+  std::fill(bytes + valid * kNumChannels * sample_size, bytes + n * kNumChannels * sample_size, 0);
+  telemetry.RecordPeriod(n, valid, fill);
+  return valid;
+}
+
+std::size_t OutputBackend::PullInt16(SampleType* samples, std::size_t n) {
+  const std::size_t max_frames = scratch.size() / kNumChannels;
+  ASSERT(max_frames > 0);
+  std::size_t valid = 0;
+  for (size_t offset = 0; offset < n;) {
+    size_t count = std::min(n - offset, max_frames);
+    size_t got = PullFloat(scratch.data(), count);
+    converter.Convert(scratch.data(), samples + offset * kNumChannels, got * kNumChannels);
+    valid += got;
+    if (got < count) {
+      break;
+    }
+    offset += count;
+  }
+  return valid;
+}
+
+std::size_t OutputBackend::PullFloat(float* out, std::size_t n) {
+  if (auto* pull_source = source.load(std::memory_order_acquire)) {
+    std::uint64_t start = ReadCycles();
+    pull_source->Render(out, n);
+    telemetry.RecordRender(n, ReadCycles() - start);
+    return n;
+  }
+
+  n = std::min(buf->ReadyToRead() / kNumChannels, n);
+  buf->Read(out, n * kNumChannels);
+  return n;
+}
+
+ClockedBackend::ClockedBackend(std::size_t buf_size, std::size_t period, bool dither)
+  : OutputBackend(buf_size, SampleFormat::kInt16, dither)
+  , period(period)
+  , samples(period * kNumChannels) {
+  ASSERT(period > 0 && period <= buf_size);
+  ReserveFrames(period);
+}
+
+ClockedBackend::~ClockedBackend() {
+  Join();
+}
+
+void ClockedBackend::Start() {
+  if (IsPlaying()) {
+    return;
+  }
+  running_ = true;
+  thread_ = std::thread(&ClockedBackend::Spin, this);
+}
+
+void ClockedBackend::Stop() {
+  Join();
+}
+
+bool ClockedBackend::IsPlaying() const {
+  return running_;
+}
+
+void ClockedBackend::Join() {
+  running_ = false;
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void ClockedBackend::Spin() {
+  using Clock = std::chrono::steady_clock;
+  const auto period_duration = std::chrono::duration_cast<Clock::duration>(
+    std::chrono::duration<double>(static_cast<double>(period) / kSampleRate));
+
+  auto deadline = Clock::now();
+  while (running_) {
+    deadline += period_duration;
+    std::this_thread::sleep_until(deadline);
+
+    Pull(samples.data(), period);
+    Consume(samples.data(), period);
+  }
+}
+
+NullBackend::NullBackend(std::size_t buf_size, std::size_t period, bool dither)
+  : ClockedBackend(buf_size, period, dither) {
+}
+
+NullBackend::~NullBackend() {
+  Join();
+}
+
+void NullBackend::Consume(const SampleType* /*samples*/, std::size_t /*n*/) {
+}
+
+FileBackend::FileBackend(const std::string& path, std::size_t buf_size, std::size_t period, bool dither)
+  : ClockedBackend(buf_size, period, dither)
+  , writer(path, FormatFromPath(path), kSampleRate, kNumChannels) {
+}
+
+FileBackend::~FileBackend() {
+  Join();
+}
+
+void FileBackend::Consume(const SampleType* samples, std::size_t n) {
+  writer.Write(samples, n * kNumChannels);
+}
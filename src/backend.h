@@ -0,0 +1,154 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "output.h"
+#include "telemetry.h"
+#include "wav_writer.h"
+
+// Renders on demand, for backends in pull mode.
+class SampleSource {
+ public:
+  virtual ~SampleSource() = default;
+
+  // n interleaved frames of kNumChannels. Called from the device callback
+  // or the backend thread: must not block.
+  virtual void Render(float* out, std::size_t n) = 0;
+};
+
+// Consumer side of the audio path. AudioThread renders into the backend's
+// ring buffer, the backend drains it at the sample rate: a sound card, a
+// clock, or a clock and a file. In pull mode there is no ring, the backend
+// asks a SampleSource for each period as it is due. Either way samples
+// stay float up to here and are converted a period at a time.
+class OutputBackend {
+ public:
+  // buf_size in frames.
+  OutputBackend(std::size_t buf_size, SampleFormat format, bool dither)
+    : buf(std::make_shared<SampleBuffer>(buf_size * kNumChannels))
+    , format(format)
+    , converter(dither) {
+  }
+  virtual ~OutputBackend() = default;
+
+  OutputBackend(const OutputBackend&) = delete;
+  OutputBackend& operator= (const OutputBackend&) = delete;
+
+  virtual void Start() = 0;
+  virtual void Stop() = 0;
+  virtual bool IsPlaying() const = 0;
+  virtual const char* GetName() const = 0;
+
+  auto GetBuffer() { return buf; }
+
+  SampleFormat GetFormat() const {
+    return format;
+  }
+
+  // Pull mode when set, the ring buffer is ignored. Set it while stopped.
+  void SetSource(SampleSource* new_source) {
+    source.store(new_source, std::memory_order_release);
+  }
+
+  // Underruns, ring levels and render times. The producer records its
+  // render times here in push mode.
+  Telemetry& GetTelemetry() {
+    return telemetry;
+  }
+
+  const Telemetry& GetTelemetry() const {
+    return telemetry;
+  }
+
+ protected:
+  // n frames into out, in the backend's format: rendered in place in pull
+  // mode, read from the ring otherwise. Frames the ring was short of are
+  // silence, like a device plays. Returns how many frames are valid. Call
+  // once per period, it is recorded in the telemetry.
+  std::size_t Pull(void* out, std::size_t n);
+
+  // Most frames Pull() converts at once, longer periods are split.
+  // Allocates, call before starting.
+  void ReserveFrames(std::size_t n) {
+    scratch.resize(n * kNumChannels);
+  }
+
+  std::shared_ptr<SampleBuffer> buf;
+  std::atomic<SampleSource*> source = nullptr;
+  SampleFormat format;
+  Telemetry telemetry;
+
+ private:
+  std::size_t PullFloat(float* out, std::size_t n);
+  std::size_t PullInt16(SampleType* out, std::size_t n);
+
+  Int16Converter converter;
+  std::vector<float> scratch;  // Floats waiting for conversion
+};
+
+// Drains the buffer from its own thread, period frames at a time, on
+// absolute deadlines so that timing errors don't accumulate. Like a sound
+// card, it takes what is there when a period is due and never waits for
+// the producer.
+class ClockedBackend : public OutputBackend {
+ public:
+  ClockedBackend(std::size_t buf_size, std::size_t period, bool dither);
+  ~ClockedBackend() override;
+
+  void Start() override;
+  void Stop() override;
+  bool IsPlaying() const override;
+
+ protected:
+  // Called from the backend thread with the n frames of one period.
+  virtual void Consume(const SampleType* samples, std::size_t n) = 0;
+
+  // Stops the thread, derived destructors have to call it before their
+  // members go away.
+  void Join();
+
+ private:
+  void Spin();
+
+  const std::size_t period;
+  std::vector<SampleType> samples;
+
+  std::thread thread_;
+  std::atomic<bool> running_ = false;
+};
+
+// Discards the samples. For profiling and load tests without audio hardware.
+class NullBackend : public ClockedBackend {
+ public:
+  NullBackend(std::size_t buf_size, std::size_t period, bool dither = false);
+  ~NullBackend() override;
+
+  const char* GetName() const override { return "null"; }
+
+ protected:
+  void Consume(const SampleType* samples, std::size_t n) override;
+};
+
+// Streams the samples to a WAV or raw file at real-time pace.
+class FileBackend : public ClockedBackend {
+ public:
+  FileBackend(const std::string& path, std::size_t buf_size, std::size_t period, bool dither = false);
+  ~FileBackend() override;
+
+  const char* GetName() const override { return "file"; }
+
+  bool IsOpen() const {
+    return writer.IsOpen();
+  }
+
+ protected:
+  void Consume(const SampleType* samples, std::size_t n) override;
+
+ private:
+  WavWriter writer;
+};
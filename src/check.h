@@ -0,0 +1,64 @@
+#pragma once
+
+#include <sstream>
+#include <stdexcept>
+
+#include <execinfo.h>
+#include <unistd.h>
+
+// Runtime checks in three tiers:
+//
+//   ASSERT        Always on. Edits, loading, plan building: anything off
+//                 the per-block path. x is always evaluated, side effects
+//                 included.
+//   DEBUG_ASSERT  Invariants the code maintains on its own, as opposed to
+//                 checks of its input. On from SYNTH_CHECK_LEVEL 1.
+//   HOT_ASSERT    Per block and per sample code, on from SYNTH_CHECK_LEVEL 2.
+//
+// A tier that is off never evaluates x and compiles to nothing, but x
+// still has to compile. Failures throw std::runtime_error, the message is
+// only formatted then.
+#ifndef SYNTH_CHECK_LEVEL
+#define SYNTH_CHECK_LEVEL 0
+#endif
+
+constexpr int kCheckLevel = SYNTH_CHECK_LEVEL;
+
+inline void PrintBacktrace() {
+  void *array[10];
+  size_t size;
+
+  // get void*'s for all entries on the stack
+  size = backtrace(array, 10);
+
+  // print out all the frames to stderr
+  // fprintf(stderr, "Error: signal %d:\n", sig);
+  backtrace_symbols_fd(array, size, STDERR_FILENO);
+}
+
+// Out of line and cold, keeps the formatting away from the checked code.
+[[noreturn, gnu::cold, gnu::noinline]]
+inline void AssertFail(const char* expr, const char* file, int line) {
+  std::ostringstream os;
+  os << "Assertion failed: 0 != 1 hint: " << expr << " is false, " << file << ":" << line;
+  PrintBacktrace();
+  throw std::runtime_error(os.str());
+}
+
+#define ASSERT(x) {                     \
+  if (!(x)) [[unlikely]] {              \
+    AssertFail(#x, __FILE__, __LINE__); \
+  }                                     \
+}
+
+#define DEBUG_ASSERT(x) {               \
+  if constexpr (kCheckLevel >= 1) {     \
+    ASSERT(x);                          \
+  }                                     \
+}
+
+#define HOT_ASSERT(x) {                 \
+  if constexpr (kCheckLevel >= 2) {     \
+    ASSERT(x);                          \
+  }                                     \
+}
@@ -0,0 +1,516 @@
+#include "execution_plan.h"
+
+#include <algorithm>
+#include <array>
+#include <map>
+#include <new>
+#include <optional>
+#include <set>
+#include <type_traits>
+
+#include "node_registry.h"
+
+namespace {
+
+const std::size_t kArenaAlignment = 64;  // Cache line
+
+// Kind of fused kernels, after the registered classes and the vtable.
+const std::size_t kFusedKind = RegisteredNodes::kSize + 1;
+
+const std::size_t kNoProducer = -1;
+
+std::size_t SlotSize(const PinData& value) {
+  std::size_t bytes = std::visit([] (const auto& v) {
+    return sizeof(v) * kMaxBlockSize;
+  }, value);
+  return (bytes + kArenaAlignment - 1) / kArenaAlignment * kArenaAlignment;
+}
+
+template <typename T>
+void FillFromFirst(const void* source, void* out, std::size_t size) {
+  const T& value = *static_cast<const T*>(source);
+  std::fill_n(static_cast<T*>(out), size, value);
+}
+
+}  // namespace
+
+void ExecutionPlan::ArenaDeleter::operator() (std::byte* ptr) const {
+  ::operator delete[](ptr, std::align_val_t(kArenaAlignment));
+}
+
+ExecutionPlan::ExecutionPlan(const std::vector<NodePtr>& sorted_nodes)
+    : nodes(sorted_nodes) {
+  // Liveness, backwards from the sinks. Consumers come after their
+  // producers, so one reverse pass is enough.
+  std::set<const Node*> live;
+  for (auto it = sorted_nodes.rbegin(); it != sorted_nodes.rend(); ++it) {
+    auto& node = *it;
+    if (!node->IsSink() && !live.contains(node.get())) {
+      continue;
+    }
+
+    live.insert(node.get());
+    for (size_t i = 0; i < node->NumInputs(); ++i) {
+      auto input = node->GetInputByIndex(i);
+      if (input->IsConnected()) {
+        live.insert(input->connection->parent);
+      }
+    }
+  }
+
+  // Rates and constness, forwards. A pure node is control rate if all its
+  // producers are, and constant if all its producers are constant.
+  // Other nodes run at the fastest rate declared by their outputs.
+  std::vector<Node*> live_nodes;
+  std::set<const Node*> control;
+  std::set<const Node*> constant;
+  for (auto& node : sorted_nodes) {
+    if (!live.contains(node.get())) {
+      ++num_eliminated;
+      continue;
+    }
+
+    live_nodes.push_back(node.get());
+    if (node->IsPure()) {
+      bool all_control = true;
+      bool all_constant = true;
+      for (size_t i = 0; i < node->NumInputs(); ++i) {
+        auto input = node->GetInputByIndex(i);
+        if (input->IsConnected()) {
+          all_control &= control.contains(input->connection->parent);
+          all_constant &= constant.contains(input->connection->parent);
+        }
+      }
+
+      if (all_control) {
+        control.insert(node.get());
+      }
+
+      if (all_constant) {
+        constant.insert(node.get());
+      }
+      continue;
+    }
+
+    bool all_control = node->NumOutputs() > 0;
+    for (size_t i = 0; i < node->NumOutputs(); ++i) {
+      all_control &= node->GetOutputByIndex(i)->rate == PinRate::kControl;
+    }
+
+    if (all_control) {
+      control.insert(node.get());
+    }
+  }
+
+  // Control-rate outputs read by audio-rate nodes get a second slot at
+  // audio rate, filled by a ramp or a broadcast.
+  std::set<const Output*> upsampled;
+  for (Node* node : live_nodes) {
+    if (control.contains(node)) {
+      continue;
+    }
+
+    for (size_t i = 0; i < node->NumInputs(); ++i) {
+      auto input = node->GetInputByIndex(i);
+      if (input->IsConnected() && control.contains(input->connection->parent)) {
+        upsampled.insert(input->connection);
+      }
+    }
+  }
+
+  // Size everything up front, kernels point into these arrays.
+  std::size_t num_inputs = 0;
+  std::size_t num_outputs = 0;
+  for (Node* node : live_nodes) {
+    num_inputs += node->NumInputs();
+    num_outputs += node->NumOutputs();
+
+    for (size_t i = 0; i < node->NumOutputs(); ++i) {
+      auto output = node->GetOutputByIndex(i);
+      arena_size += SlotSize(output->value);
+      if (upsampled.contains(output)) {
+        arena_size += SlotSize(output->value);
+      }
+    }
+
+    for (size_t i = 0; i < node->NumInputs(); ++i) {
+      auto input = node->GetInputByIndex(i);
+      if (!input->IsConnected()) {
+        arena_size += SlotSize(input->default_value);
+      }
+    }
+  }
+
+  input_ptrs.resize(num_inputs);
+  input_connected.resize(num_inputs);
+  output_ptrs.resize(num_outputs);
+  arena.reset(static_cast<std::byte*>(::operator new[](
+    std::max<std::size_t>(arena_size, 1), std::align_val_t(kArenaAlignment))));
+
+  // Outputs get their slots before any input is resolved.
+  std::map<const Output*, void*> output_slots;
+  std::map<const Output*, void*> upsampled_slots;
+  std::size_t output_offset = 0;
+  for (Node* node : live_nodes) {
+    for (size_t i = 0; i < node->NumOutputs(); ++i) {
+      auto output = node->GetOutputByIndex(i);
+      void* slot = AllocateSlot(output->value);
+      output_ptrs[output_offset++] = slot;
+      MapInsert(output_slots, output, slot);
+
+      if (!upsampled.contains(output)) {
+        continue;
+      }
+
+      void* audio_slot = AllocateSlot(output->value);
+      MapInsert(upsampled_slots, output, audio_slot);
+      if (output->type == PinDataType::kFloat) {
+        Ramp ramp;
+        ramp.source = static_cast<const float*>(slot);
+        ramp.out = static_cast<float*>(audio_slot);
+        ramps.push_back(ramp);
+      } else {
+        auto fill = std::visit([] (const auto& v) {
+          return &FillFromFirst<std::decay_t<decltype(v)>>;
+        }, output->value);
+        broadcasts.push_back({slot, audio_slot, fill});
+      }
+    }
+  }
+
+  // One batch function per registered class, the last one for any other class.
+  static const auto batch_fns = [] <typename... Ts> (NodeList<Ts...>) {
+    return std::array<BatchFn, sizeof...(Ts) + 1>{&RunBatch<Ts>..., &RunBatch<Node>};
+  }(RegisteredNodes{});
+
+  kernels.reserve(live_nodes.size());
+  std::size_t input_offset = 0;
+  output_offset = 0;
+  for (Node* node : live_nodes) {
+    bool is_control = control.contains(node);
+    Kernel kernel;
+    kernel.node = node;
+    kernel.io.inputs = input_ptrs.data() + input_offset;
+    kernel.io.outputs = output_ptrs.data() + output_offset;
+    kernel.io.connected = input_connected.data() + input_offset;
+    kernel.kind = RegisteredNodes::IndexOf(*node);
+    kernel.run = batch_fns[kernel.kind];
+
+    for (size_t i = 0; i < node->NumInputs(); ++i) {
+      auto input = node->GetInputByIndex(i);
+      if (input->IsConnected()) {
+        const Output* producer_output = input->connection;
+        const Node* producer = producer_output->parent;
+        input_connected[input_offset] = 1;
+        if (!control.contains(producer)) {
+          input_ptrs[input_offset] = MapGetConstRef(output_slots, producer_output);
+        } else if (is_control) {
+          input_ptrs[input_offset] = MapGetConstRef(output_slots, producer_output);
+        } else {
+          input_ptrs[input_offset] = MapGetConstRef(upsampled_slots, producer_output);
+        }
+      } else {
+        input_ptrs[input_offset] = AllocateSlot(input->default_value);
+        input_connected[input_offset] = 0;
+      }
+      ++input_offset;
+    }
+
+    output_offset += node->NumOutputs();
+    if (constant.contains(node)) {
+      constant_kernels.push_back(kernel);
+    } else if (is_control) {
+      control_kernels.push_back(kernel);
+    } else if (node->IsSink() && node->NumOutputs() == 0) {
+      sink_kernels.push_back(kernel);
+    } else {
+      kernels.push_back(kernel);
+    }
+  }
+
+  ASSERT_EQUAL(arena_used, arena_size);
+  FuseKernels();
+
+  // Group by level, then by class inside each level, keeping the
+  // topological order otherwise.
+  std::stable_sort(kernels.begin(), kernels.end(), [] (const Kernel& a, const Kernel& b) {
+    return a.level != b.level ? a.level < b.level : a.kind < b.kind;
+  });
+
+  for (size_t i = 0; i < kernels.size(); ++i) {
+    if (i + 1 == kernels.size() || kernels[i + 1].level != kernels[i].level) {
+      level_end.push_back(i + 1);
+      max_level_width = std::max(max_level_width, level_end.back() - LevelBegin(level_end.size() - 1));
+    }
+    if (i + 1 == kernels.size() || kernels[i + 1].level != kernels[i].level || kernels[i + 1].kind != kernels[i].kind) {
+      batch_end.push_back(i + 1);
+    }
+  }
+}
+
+template <typename T>
+void ExecutionPlan::RunBatch(const Kernel* begin, const Kernel* end, const BlockInfo& info,
+                             ProfiledSequence& sequence) {
+  for (const Kernel* kernel = begin; kernel != end; ++kernel) {
+    sequence.Run(kernel->node->GetProfile(), [&] {
+      if constexpr (std::is_same_v<T, Node>) {
+        kernel->node->ProcessBlock(info, kernel->io);
+      } else {
+        static_cast<T*>(kernel->node)->T::ProcessBlock(info, kernel->io);
+      }
+    });
+  }
+}
+
+void ExecutionPlan::RunFused(const Kernel* begin, const Kernel* end, const BlockInfo& info,
+                             ProfiledSequence& sequence) {
+  for (const Kernel* kernel = begin; kernel != end; ++kernel) {
+    sequence.Run(kernel->node->GetProfile(), [&] { kernel->fused->Run(info.size); });
+  }
+}
+
+void ExecutionPlan::FuseKernels() {
+  std::map<const Node*, std::size_t> index;
+  std::vector<std::optional<ElementwiseOp>> ops(kernels.size());
+  for (size_t i = 0; i < kernels.size(); ++i) {
+    index[kernels[i].node] = i;
+    if (kernels[i].node->NumOutputs() == 1 && kernels[i].node->NumInputs() <= 3) {
+      ops[i] = kernels[i].node->GetElementwiseOp(kernels[i].io);
+    }
+  }
+
+  // Readers of every output, at any rate.
+  std::map<const Output*, std::size_t> num_readers;
+  for (const auto* list : {&constant_kernels, &control_kernels, &kernels, &sink_kernels}) {
+    for (const auto& kernel : *list) {
+      for (size_t i = 0; i < kernel.node->NumInputs(); ++i) {
+        auto input = kernel.node->GetInputByIndex(i);
+        if (input->IsConnected()) {
+          ++num_readers[input->connection];
+        }
+      }
+    }
+  }
+
+  // Kernel computing every input, kNoProducer for inputs not connected to
+  // an audio-rate node.
+  std::vector<std::vector<std::size_t>> producers(kernels.size());
+  for (size_t i = 0; i < kernels.size(); ++i) {
+    for (size_t k = 0; k < kernels[i].node->NumInputs(); ++k) {
+      auto input = kernels[i].node->GetInputByIndex(k);
+      auto it = input->IsConnected() ? index.find(input->connection->parent) : index.end();
+      producers[i].push_back(it != index.end() ? it->second : kNoProducer);
+    }
+  }
+
+  // Producers first, so a group is complete when its consumer is reached.
+  std::vector<std::uint8_t> fused(kernels.size(), 0);
+  std::vector<std::size_t> group_size(kernels.size(), 1);
+  for (size_t i = 0; i < kernels.size(); ++i) {
+    if (!ops[i]) {
+      continue;
+    }
+
+    std::vector<std::size_t> members;
+    for (std::size_t p : producers[i]) {
+      if (p != kNoProducer && ops[p] && num_readers[kernels[p].node->GetOutputByIndex(0)] == 1) {
+        members.push_back(p);
+        group_size[i] += group_size[p];
+      }
+    }
+
+    if (group_size[i] > kMaxFusedNodes) {
+      members.clear();
+      group_size[i] = 1;
+    }
+
+    for (std::size_t p : members) {
+      fused[p] = 1;
+    }
+  }
+
+  // Control-rate nodes run before the first level and don't count. A fused
+  // node runs within the level of its consumer.
+  for (size_t i = 0; i < kernels.size(); ++i) {
+    for (std::size_t p : producers[i]) {
+      if (p != kNoProducer) {
+        kernels[i].level = std::max(kernels[i].level, kernels[p].level + (fused[p] ? 0 : 1));
+      }
+    }
+  }
+
+  // Steps in post order. Temporaries are reused as soon as they are read,
+  // an op may write over its own input.
+  struct Builder {
+    const std::vector<Kernel>& kernels;
+    const std::vector<std::optional<ElementwiseOp>>& ops;
+    const std::vector<std::uint8_t>& fused;
+    const std::vector<std::vector<std::size_t>>& producers;
+
+    std::vector<FusedStep> steps;
+    std::vector<std::array<int, 4>> temporaries;  // Per step: in[0..2], out. -1 for arena slots
+    std::vector<int> free_temporaries;
+    int num_temporaries = 0;
+
+    int Emit(std::size_t i, bool last) {
+      FusedStep step;
+      step.op = *ops[i];
+      std::array<int, 4> temporary = {-1, -1, -1, -1};
+      for (size_t k = 0; k < step.op.NumInputs(); ++k) {
+        std::size_t p = producers[i][k];
+        if (p != kNoProducer && fused[p]) {
+          temporary[k] = Emit(p, false);
+        } else {
+          step.in[k] = kernels[i].io.In<float>(k);
+          step.in_stride[k] = 1;
+        }
+      }
+
+      for (size_t k = 0; k < 3; ++k) {
+        if (temporary[k] >= 0) {
+          free_temporaries.push_back(temporary[k]);
+        }
+      }
+
+      if (last) {
+        step.out = kernels[i].io.Out<float>(0);
+        step.out_stride = 1;
+      } else if (!free_temporaries.empty()) {
+        temporary[3] = free_temporaries.back();
+        free_temporaries.pop_back();
+      } else {
+        temporary[3] = num_temporaries++;
+      }
+
+      steps.push_back(step);
+      temporaries.push_back(temporary);
+      return temporary[3];
+    }
+  };
+
+  std::size_t num_groups = 0;
+  for (size_t i = 0; i < kernels.size(); ++i) {
+    num_groups += ops[i] && !fused[i] && group_size[i] > 1;
+  }
+  fused_kernels.reserve(num_groups);
+
+  std::vector<Kernel> remaining;
+  for (size_t i = 0; i < kernels.size(); ++i) {
+    if (fused[i]) {
+      ++num_fused;
+      continue;
+    }
+
+    Kernel kernel = kernels[i];
+    if (ops[i] && group_size[i] > 1) {
+      Builder builder{kernels, ops, fused, producers};
+      builder.Emit(i, true);
+
+      auto& fused_kernel = fused_kernels.emplace_back();
+      fused_kernel.temporaries.resize(builder.num_temporaries);
+      for (size_t s = 0; s < builder.steps.size(); ++s) {
+        FusedStep step = builder.steps[s];
+        for (size_t k = 0; k < 4; ++k) {
+          int temporary = builder.temporaries[s][k];
+          if (temporary < 0) {
+            continue;
+          }
+          float* data = fused_kernel.temporaries[temporary].data;
+          if (k < 3) {
+            step.in[k] = data;
+          } else {
+            step.out = data;
+          }
+        }
+        fused_kernel.steps.push_back(step);
+      }
+
+      kernel.kind = kFusedKind;
+      kernel.run = &RunFused;
+      kernel.fused = &fused_kernel;
+    }
+    remaining.push_back(kernel);
+  }
+  kernels = std::move(remaining);
+}
+
+void* ExecutionPlan::AllocateSlot(const PinData& value) {
+  std::size_t size = SlotSize(value);
+  ASSERT(arena_used + size <= arena_size);
+  std::byte* slot = arena.get() + arena_used;
+  arena_used += size;
+
+  std::visit([slot] (const auto& v) {
+    using T = std::decay_t<decltype(v)>;
+    static_assert(std::is_trivially_destructible_v<T>);
+    std::uninitialized_fill_n(reinterpret_cast<T*>(slot), kMaxBlockSize, v);
+  }, value);
+  return slot;
+}
+
+void ExecutionPlan::Ramp::Run(std::size_t size) {
+  float value = *source;
+  if (!primed) {
+    // No glide from the default value when the plan starts.
+    current = value;
+    target = value;
+    primed = true;
+  }
+
+  if (value != target) {
+    target = value;
+    remaining = kControlRampSize;
+    step = (target - current) / kControlRampSize;
+  }
+
+  std::size_t i = 0;
+  for (; i < size && remaining > 0; ++i) {
+    // Land exactly on the target, whatever the rounding on the way.
+    current = --remaining == 0 ? target : current + step;
+    out[i] = current;
+  }
+  std::fill(out + i, out + size, current);
+}
+
+void ExecutionPlan::BeginBlock(std::uint64_t param_version, const BlockInfo& info) {
+  BlockInfo control_info = info;
+  control_info.size = 1;
+
+  if (!constants_ready || constants_version != param_version) {
+    ProfiledSequence sequence;
+    for (const auto& kernel : constant_kernels) {
+      sequence.Run(kernel.node->GetProfile(), [&] { kernel.node->ProcessBlock(control_info, kernel.io); });
+    }
+    constants_version = param_version;
+    constants_ready = true;
+  }
+
+  ProfiledSequence sequence;
+  for (const auto& kernel : control_kernels) {
+    sequence.Run(kernel.node->GetProfile(), [&] { kernel.node->ProcessBlock(control_info, kernel.io); });
+  }
+
+  for (auto& ramp : ramps) {
+    ramp.Run(info.size);
+  }
+
+  for (const auto& broadcast : broadcasts) {
+    broadcast.fill(broadcast.source, broadcast.out, info.size);
+  }
+}
+
+void ExecutionPlan::Execute(const BlockInfo& info) {
+  ProfiledSequence sequence;
+  std::size_t begin = 0;
+  for (std::size_t end : batch_end) {
+    kernels[begin].run(kernels.data() + begin, kernels.data() + end, info, sequence);
+    begin = end;
+  }
+}
+
+void ExecutionPlan::EndBlock(const BlockInfo& info) {
+  ProfiledSequence sequence;
+  for (const auto& kernel : sink_kernels) {
+    kernel.run(&kernel, &kernel + 1, info, sequence);
+  }
+}
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "node.h"
+
+// Samples over which a control-rate value glides to its new value
+// when read at audio rate. About 6 ms, enough to hide zipper noise.
+const std::size_t kControlRampSize = 256;
+
+// Nodes fused into one kernel at most. Large trees of elementwise nodes
+// still split into several kernels, which can run in parallel.
+const std::size_t kMaxFusedNodes = 16;
+
+// Flat form of a sorted graph, the only thing the audio thread executes.
+// Compiled after every topology change and never modified afterwards,
+// except for the sample data in the arena. The plan shares ownership of
+// its nodes, so a node removed from the graph stays alive until the audio
+// thread is done with the last plan referencing it.
+//
+// Every output pin and every unconnected input owns one slot of the arena.
+// Inputs are resolved at compile time: a connected input points to the slot
+// of its output, an unconnected one to a slot filled with its default value.
+//
+// Kernels are grouped by dependency level: a kernel only reads outputs of
+// kernels in lower levels, so kernels of one level may run in parallel.
+// Within a level they are grouped by node class. Nodes of the classes in
+// RegisteredNodes run through a function made for their class that calls
+// ProcessBlock directly, one call per run of nodes of that class. Other
+// nodes are called through the vtable.
+//
+// Sinks without outputs are left out of the levels and run one after
+// another on the calling thread once the levels are done, in topological
+// order. They write state shared outside of the graph, like the
+// AudioOutput block, so two of them must never run at once.
+//
+// Elementwise nodes (see Node::GetElementwiseOp) whose output is read only
+// by one other elementwise node are fused into the kernel of that node. A
+// fused kernel runs all ops of its chain or tree on kFusedChunk samples at
+// a time, so intermediate results stay in L1. The output slots of the fused
+// nodes are never written.
+// Its time is counted on the profile of the last node. The graph and the
+// editor still see every node.
+//
+// Several passes trim the graph before that. Nodes with no path to a sink
+// are dropped. Rates are inferred: nodes whose outputs are all control rate,
+// and pure nodes fed only by control-rate pins, run once per block on a
+// single sample. Among them, pure nodes whose inputs are all constant are
+// folded and only rerun after a parameter change. Audio-rate inputs read
+// control-rate float outputs through a ramp, other types are repeated over
+// the block.
+class ExecutionPlan {
+ public:
+  explicit ExecutionPlan(const std::vector<NodePtr>& sorted_nodes);
+
+  // Audio thread, before Execute or the levels of this block. Reruns the
+  // folded kernels if param_version moved since the last call, then runs
+  // the control-rate kernels and the ramps to audio rate.
+  void BeginBlock(std::uint64_t param_version, const BlockInfo& info);
+
+  // Runs every kernel in order for one block.
+  void Execute(const BlockInfo& info);
+
+  // Audio thread, after Execute or the levels of this block. Runs the sinks.
+  void EndBlock(const BlockInfo& info);
+
+  void RunKernel(std::size_t idx, const BlockInfo& info) {
+    const auto& kernel = kernels[idx];
+    ProfiledSequence sequence;
+    kernel.run(&kernel, &kernel + 1, info, sequence);
+  }
+
+  std::size_t NumKernels() const {
+    return kernels.size();
+  }
+
+  std::size_t NumLevels() const {
+    return level_end.size();
+  }
+
+  // Kernels of a level occupy [LevelBegin(level), LevelEnd(level)).
+  std::size_t LevelBegin(std::size_t level) const {
+    return level == 0 ? 0 : level_end[level - 1];
+  }
+
+  std::size_t LevelEnd(std::size_t level) const {
+    return level_end[level];
+  }
+
+  std::size_t LevelOf(std::size_t idx) const {
+    return kernels[idx].level;
+  }
+
+  std::size_t MaxLevelWidth() const {
+    return max_level_width;
+  }
+
+  std::size_t ArenaSize() const {
+    return arena_size;
+  }
+
+  std::size_t NumFolded() const {
+    return constant_kernels.size();
+  }
+
+  std::size_t NumControl() const {
+    return control_kernels.size();
+  }
+
+  std::size_t NumRamps() const {
+    return ramps.size();
+  }
+
+  std::size_t NumEliminated() const {
+    return num_eliminated;
+  }
+
+  // Nodes running inside the kernel of another node.
+  std::size_t NumFused() const {
+    return num_fused;
+  }
+
+  // Runs of kernels of one class that Execute() dispatches at once.
+  std::size_t NumBatches() const {
+    return batch_end.size();
+  }
+
+ private:
+  struct Kernel;
+
+  // Runs ProcessBlock of kernels [begin, end), all of one node class.
+  using BatchFn = void (*)(const Kernel* begin, const Kernel* end, const BlockInfo& info,
+                           ProfiledSequence& sequence);
+
+  // Ops of a chain or tree of elementwise nodes, producers first. Results
+  // read by the next op go through temporaries, the last step writes the
+  // output slot of the kernel's node.
+  struct FusedKernel {
+    struct alignas(64) Temporary {
+      float data[kFusedChunk];
+    };
+
+    std::vector<FusedStep> steps;
+    std::vector<Temporary> temporaries;
+
+    void Run(std::size_t size) const {
+      GetBlockKernels().run_fused(steps.data(), steps.size(), size);
+    }
+  };
+
+  struct Kernel {
+    Node* node;
+    BlockIO io;
+    std::size_t level = 0;
+    std::size_t kind;  // Index of the node class in RegisteredNodes
+    BatchFn run;
+    const FusedKernel* fused = nullptr;
+  };
+
+  // Calls T::ProcessBlock, or Node::ProcessBlock virtually for T = Node.
+  template <typename T>
+  static void RunBatch(const Kernel* begin, const Kernel* end, const BlockInfo& info,
+                       ProfiledSequence& sequence);
+
+  // Runs the fused kernels [begin, end).
+  static void RunFused(const Kernel* begin, const Kernel* end, const BlockInfo& info,
+                       ProfiledSequence& sequence);
+
+  // Linear glide of a control-rate float to audio rate.
+  struct Ramp {
+    const float* source;
+    float* out;
+    float current = 0.0f;
+    float target = 0.0f;
+    float step = 0.0f;
+    std::size_t remaining = 0;
+    bool primed = false;
+
+    void Run(std::size_t size);
+  };
+
+  // Repeats the first element of a control-rate buffer over the block.
+  struct Broadcast {
+    const void* source;
+    void* out;
+    void (*fill)(const void* source, void* out, std::size_t size);
+  };
+
+  struct ArenaDeleter {
+    void operator() (std::byte* ptr) const;
+  };
+
+  // Reserves a slot and fills it with kMaxBlockSize copies of value.
+  void* AllocateSlot(const PinData& value);
+
+  // Moves elementwise kernels into the kernel of their consumer and assigns
+  // the levels. kernels are still in topological order.
+  void FuseKernels();
+
+  std::vector<NodePtr> nodes;  // Also dead ones: queued param changes may point to them
+  std::vector<Kernel> kernels;  // Audio rate, sorted by level
+  std::vector<std::size_t> level_end;
+  std::vector<std::size_t> batch_end;  // Same as level_end, also split where the class changes
+  std::vector<FusedKernel> fused_kernels;  // Sized once, kernels point to them
+  std::size_t max_level_width = 0;
+
+  // Topological order
+  std::vector<Kernel> constant_kernels;
+  std::vector<Kernel> control_kernels;
+  std::vector<Kernel> sink_kernels;
+  std::vector<Ramp> ramps;
+  std::vector<Broadcast> broadcasts;
+
+  std::uint64_t constants_version = 0;
+  bool constants_ready = false;
+  std::size_t num_eliminated = 0;
+  std::size_t num_fused = 0;
+
+  // Kernels keep pointers into these, so they are sized once and never grow.
+  std::vector<const void*> input_ptrs;
+  std::vector<void*> output_ptrs;
+  std::vector<std::uint8_t> input_connected;
+
+  std::unique_ptr<std::byte[], ArenaDeleter> arena;
+  std::size_t arena_size = 0;
+  std::size_t arena_used = 0;
+};
@@ -2,10 +2,9 @@
 
 #include <optional>
 #include <string>
-#include <fstream>
 
 #include "multigraph.h"
-#include "json.hpp"
+#include "patch_file.h"
 #include "portable-file-dialogs.h"
 
 struct FileMenu {
@@ -44,21 +43,19 @@ struct FileMenu {
       return;
     }
     
-    nlohmann::json j;
-    std::ifstream f(selection[0]);
-    f >> j;
-    
-    LoadGraph(*graph, j, *factory);
+    // JSON or binary. All or nothing, the audio thread never sees half of it.
+    auto access = graph->GetAccess();
+    if (!LoadPatchFile(*access.obj, selection[0], *factory)) {
+      std::cout << "Invalid patch " << selection[0] << std::endl;
+    }
   }
   
  private:
+  // Binary if dst ends in kPatchExtension.
   void SaveImpl(const std::string& dst) {
-    std::ofstream f(dst);
-    
-    auto j = nlohmann::json::object();
-    SaveGraph(*graph, j);
-
-    f << j;
+    if (!SavePatchFile(*graph, dst)) {
+      std::cout << "Can't save " << dst << std::endl;
+    }
   }
 
   std::shared_ptr<Multigraph> graph;
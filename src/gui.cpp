@@ -11,6 +11,10 @@ Gui::Gui(
     , audio_thread(audio_thread)
     , file_menu(graph, factory) {
   InitWindow();
+  if constexpr (kProfilingEnabled) {
+    // Calibrates once, here rather than in the first frame.
+    CyclesPerSecond();
+  }
 }
 
 Gui::~Gui() {
@@ -141,6 +145,7 @@ void Gui::DrawFrame() {
         return;
     }
     
+    UpdateProfile();
     DrawToolbar();
     // Start interaction with editor.
     ed::Begin("My Editor", ImVec2(0.0f, 0.0f));
@@ -169,8 +174,8 @@ void Gui::DrawFrame() {
       // NodePtr node = attrs.ptr;
         // attrs.position = Position{100 * num_traversed, 0};
       // }
-      ed::NodeId g_node_id = node_id;
-      auto& node_pins = MapGetConstRef(pins.node_to_pins, node_id);
+      ed::NodeId g_node_id = node_id.Pack();
+      auto& node_pins = pins.GetNodePins(node_id);
       ed::BeginNode(g_node_id);
           if (!wrapper.attrs->is_placed) {
             ed::SetNodePosition(g_node_id, ImVec2(wrapper.attrs->pos_x, wrapper.attrs->pos_y));
@@ -183,6 +188,14 @@ void Gui::DrawFrame() {
 
           ImGui::BeginGroup();
           ImGui::Text("%s", node->GetDisplayName().c_str());
+          if constexpr (kProfilingEnabled) {
+            if (auto it = node_costs.find(node_id); it != node_costs.end()) {
+              double percent = it->second.load * 100;
+              ImGui::SameLine();
+              ImGui::TextColored(
+                percent >= 10 ? ImVec4(1, 0.4, 0.4, 1) : ImVec4(0.6, 0.6, 0.6, 1), "%.1f%%", percent);
+            }
+          }
           ImGui::EndGroup();
           ImGui::BeginGroup();
           ImGuiEx_BeginColumn();
@@ -190,7 +203,7 @@ void Gui::DrawFrame() {
               auto pin_id = node_pins.inputs[input_idx];
               auto input = node->GetInputByIndex(input_idx);
 
-              ed::PinId g_pin_id = pin_id;
+              ed::PinId g_pin_id = pin_id.Pack();
 
               ImVec2 p = ImGui::GetCursorScreenPos();
               p.x -= TEXT_BASE_WIDTH;
@@ -200,13 +213,14 @@ void Gui::DrawFrame() {
               ed::BeginPin(g_pin_id, ed::PinKind::Input);
                   ed::PinRect(ImVec2(p.x-5, p.y-5), ImVec2(p.x+5, p.y+5));
                   // ImGui::Bullet();
-                  ImGui::Text("%s %d", input->name.c_str(), pin_id);
+                  ImGui::Text("%s %u", input->name.c_str(), pin_id.index);
               ed::EndPin();
             }
 
           ImGuiEx_NextColumn();
 
           node->Draw();
+          node->FlushParams(graph->GetParamQueue(), audio_thread->GetPosition());
 
           ImGuiEx_NextColumn();
 
@@ -214,9 +228,9 @@ void Gui::DrawFrame() {
               auto pin_id = node_pins.outputs[output_idx];
               auto output = node->GetOutputByIndex(output_idx);
 
-              ed::PinId g_pin_id = pin_id;
+              ed::PinId g_pin_id = pin_id.Pack();
               ed::BeginPin(g_pin_id, ed::PinKind::Output);
-                  ImGui::Text("%s %d", output->name.c_str(), pin_id);
+                  ImGui::Text("%s %u", output->name.c_str(), pin_id.index);
                   ImGui::SameLine();
                   ImVec2 p = ImGui::GetCursorScreenPos();
                   // p.x += TEXT_BASE_WIDTH;
@@ -232,10 +246,12 @@ void Gui::DrawFrame() {
       ed::EndNode();
     }
 
+    graph->CollectGarbage();
+
     // Submit Links
     for (auto& [link_id, pins] : links.link_id_to_pins) {
-      ed::LinkId g_link_id = link_id;
-      ed::Link(g_link_id, pins.first, pins.second);
+      ed::LinkId g_link_id = link_id.Pack();
+      ed::Link(g_link_id, pins.first.Pack(), pins.second.Pack());
     }
 
     //
@@ -260,12 +276,12 @@ void Gui::DrawFrame() {
             //   * input invalid, output valid - user started to drag new ling from output pin
             //   * input valid, output valid   - user dragged link over other pin, can be validated
 
-            int new_link_id = -1;
+            link_id_t new_link_id;
             
-            pin_id_t input_pin = static_cast<pin_id_t>(size_t(inputPinId));
-            pin_id_t output_pin = static_cast<pin_id_t>(size_t(outputPinId));
-            bool res = graph->CanAddLink(input_pin, output_pin);
-            if (res && inputPinId && outputPinId) // both are valid, let's accept link
+            pin_id_t input_pin = pin_id_t::Unpack(size_t(inputPinId));
+            pin_id_t output_pin = pin_id_t::Unpack(size_t(outputPinId));
+            bool res = input_pin.IsValid() && output_pin.IsValid() && graph->CanAddLink(input_pin, output_pin);
+            if (res) // both are valid, let's accept link
             {
 
                 // ed::AcceptNewItem() return true when user release mouse button.
@@ -273,7 +289,7 @@ void Gui::DrawFrame() {
                 {
                     // Since we accepted new link, lets add one to our list of links.
                     bool res = graph->GetAccess()->AddLink(input_pin, output_pin, &new_link_id);
-                    ed::Link(new_link_id, inputPinId, outputPinId);
+                    ed::Link(new_link_id.Pack(), inputPinId, outputPinId);
                 }
 
                 // You may choose to reject connection between these nodes
@@ -296,7 +312,7 @@ void Gui::DrawFrame() {
             // If you agree that link can be deleted, accept deletion.
             if (ed::AcceptDeletedItem())
             {
-              int link_id = static_cast<int>(size_t(deletedLinkId));
+              link_id_t link_id = link_id_t::Unpack(size_t(deletedLinkId));
               graph->GetAccess()->RemoveLink(link_id);
             }
 
@@ -307,7 +323,7 @@ void Gui::DrawFrame() {
         ed::NodeId deletedNodeId;
         while (ed::QueryDeletedNode(&deletedNodeId)) {
           if (ed::AcceptDeletedItem()) {
-            int node_id = static_cast<int>(size_t(deletedNodeId));
+            node_id_t node_id = node_id_t::Unpack(size_t(deletedNodeId));
             graph->GetAccess()->RemoveNode(node_id);
           }
         } 
@@ -335,6 +351,16 @@ void Gui::DrawFrame() {
     ed::SetCurrentEditor(nullptr);
     ImGui::End();
 
+    if constexpr (kProfilingEnabled) {
+      if (show_profiler) {
+        DrawProfiler();
+      }
+    }
+
+    if (show_telemetry) {
+      DrawTelemetry();
+    }
+
     g_FirstFrame = false;
 
     // ImGui::ShowMetricsWindow();
@@ -380,9 +406,191 @@ void Gui::DrawToolbar() {
   
   ImGui::Text("%.3f", audio_thread->GetTimestamp());
 
+  if constexpr (kProfilingEnabled) {
+    ImGui::SameLine();
+    char overlay[32];
+    snprintf(overlay, sizeof(overlay), "DSP %.1f%%", dsp_load * 100);
+    ImGui::ProgressBar(std::min(dsp_load, 1.0), ImVec2(200, 0), overlay);
+    ImGui::SameLine();
+    ImGui::Checkbox("Profiler", &show_profiler);
+  }
+
+  ImGui::SameLine();
+  ImGui::Checkbox("Audio", &show_telemetry);
+
   ImGui::EndGroup();
 }
 
+// Underruns, ring level and render times, to line glitches up with edits.
+void Gui::DrawTelemetry() {
+  if (!ImGui::Begin("Audio", &show_telemetry)) {
+    ImGui::End();
+    return;
+  }
+
+  const auto& backend = audio_thread->GetBackend();
+  const auto& telemetry = backend->GetTelemetry();
+  auto stats = telemetry.GetSnapshot() - telemetry_base;
+  bool push = audio_thread->GetMode() == RenderMode::kPush;
+
+  ImGui::Text("Backend %s, %s mode", backend->GetName(), push ? "push" : "pull");
+  ImGui::SameLine();
+  if (ImGui::Button("Reset")) {
+    telemetry_base = telemetry.GetSnapshot();
+  }
+
+  ImGui::Text("Periods %llu, underruns %llu, silence %.3f s, device xruns %llu",
+    static_cast<unsigned long long>(stats.periods),
+    static_cast<unsigned long long>(stats.underruns),
+    stats.missing_frames / static_cast<double>(kSampleRate),
+    static_cast<unsigned long long>(stats.device_xruns));
+  if (stats.underruns > 0) {
+    ImGui::TextColored(ImVec4(1, 0.4, 0.4, 1), "Last underrun %.1f s ago",
+      (stats.frames + telemetry_base.frames - stats.last_underrun) / static_cast<double>(kSampleRate));
+  }
+
+  if (push) {
+    auto fill = telemetry.GetFillHistory();
+    float size = static_cast<float>(backend->GetBuffer()->Size() / kNumChannels);
+    ImGui::PlotLines("Ring frames", fill.data(), static_cast<int>(fill.size()), 0, nullptr, 0, size, ImVec2(0, 80));
+  }
+
+  std::array<float, TelemetrySnapshot::kNumBins> histogram;
+  std::uint64_t renders = 0;
+  for (std::size_t bin = 0; bin < histogram.size(); ++bin) {
+    histogram[bin] = static_cast<float>(stats.deadline_histogram[bin]);
+    renders += stats.deadline_histogram[bin];
+  }
+  std::uint64_t late = stats.deadline_histogram[histogram.size() - 2] + stats.deadline_histogram[histogram.size() - 1];
+  char overlay[64];
+  snprintf(overlay, sizeof(overlay), "%llu of %llu late, worst %.0f%%",
+    static_cast<unsigned long long>(late), static_cast<unsigned long long>(renders), stats.worst_load * 100);
+  ImGui::PlotHistogram("Render time / deadline", histogram.data(), static_cast<int>(histogram.size()),
+    0, overlay, 0, FLT_MAX, ImVec2(0, 80));
+  ImGui::TextDisabled("Bins of 10%% up to the deadline, then up to 2x and beyond");
+
+  ImGui::End();
+}
+
+// Turns the counters' running totals into loads over the last window.
+// Windows are measured in rendered audio, so nothing moves while paused.
+void Gui::UpdateProfile() {
+  if constexpr (!kProfilingEnabled) {
+    return;
+  }
+
+  std::uint64_t position = audio_thread->GetPosition();
+  if (position - profile_position < kSampleRate / 4) {
+    return;
+  }
+  double audio_seconds = (position - profile_position) / static_cast<double>(kSampleRate);
+  double cycles_per_second = CyclesPerSecond();
+  bool valid = profile_position != 0;  // Else this is the first snapshot
+  profile_position = position;
+
+  auto seconds = [&](std::uint64_t cycles) {
+    return cycles / cycles_per_second;
+  };
+
+  std::uint64_t cycles = audio_thread->GetRenderProfile().Cycles();
+  dsp_load = valid ? seconds(cycles - render_cycles) / audio_seconds : 0;
+  render_cycles = cycles;
+
+  // Rebuilt each time so that removed nodes drop out.
+  std::map<node_id_t, NodeCost> costs;
+  for (auto& [node_id, wrapper] : graph->GetNodes()) {
+    const auto& profile = wrapper.node->GetProfile();
+    NodeCost cost;
+    cost.cycles = profile.Cycles();
+    cost.calls = profile.Calls();
+    auto it = node_costs.find(node_id);
+    if (valid && it != node_costs.end()) {
+      std::uint64_t window_cycles = cost.cycles - it->second.cycles;
+      std::uint64_t window_calls = cost.calls - it->second.calls;
+      cost.load = seconds(window_cycles) / audio_seconds;
+      cost.us_per_call = window_calls ? seconds(window_cycles) * 1e6 / window_calls : 0;
+    }
+    costs[node_id] = cost;
+  }
+  node_costs = std::move(costs);
+}
+
+// Nodes by cost and memory, sortable by any column.
+void Gui::DrawProfiler() {
+  if (!ImGui::Begin("Profiler", &show_profiler)) {
+    ImGui::End();
+    return;
+  }
+
+  ImGui::Text("DSP load %.1f%%, %zu render threads", dsp_load * 100, audio_thread->NumThreads());
+  auto memory = GetPatchMemory(*graph);
+  auto arena = factory->GetArena().GetStats();
+  ImGui::Text("Memory %.1f KiB in nodes, %.1f KiB in graph, %zu B/node, arena %.1f KiB reserved",
+              memory.node_bytes / 1024.0, memory.graph_bytes / 1024.0, memory.BytesPerNode(),
+              arena.reserved / 1024.0);
+
+  struct Row {
+    node_id_t node_id;
+    const std::string* name;
+    const NodeCost* cost;
+    std::size_t bytes;
+  };
+  std::vector<Row> rows;
+  for (auto& [node_id, wrapper] : graph->GetNodes()) {
+    if (auto it = node_costs.find(node_id); it != node_costs.end()) {
+      rows.push_back({node_id, &wrapper.node->GetDisplayName(), &it->second, wrapper.node->GetMemoryUsage()});
+    }
+  }
+
+  const auto flags = ImGuiTableFlags_Sortable | ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders
+    | ImGuiTableFlags_ScrollY | ImGuiTableFlags_Resizable;
+  if (ImGui::BeginTable("top_nodes", 5, flags)) {
+    ImGui::TableSetupColumn("Node");
+    ImGui::TableSetupColumn("Id", ImGuiTableColumnFlags_DefaultSort);
+    ImGui::TableSetupColumn("Load %", ImGuiTableColumnFlags_PreferSortDescending);
+    ImGui::TableSetupColumn("us/block", ImGuiTableColumnFlags_PreferSortDescending);
+    ImGui::TableSetupColumn("Bytes", ImGuiTableColumnFlags_PreferSortDescending);
+    ImGui::TableSetupScrollFreeze(0, 1);
+    ImGui::TableHeadersRow();
+
+    // Resorted every frame, the loads change under the sort anyway.
+    if (auto specs = ImGui::TableGetSortSpecs(); specs && specs->SpecsCount > 0) {
+      const auto& spec = specs->Specs[0];
+      auto key = [&](const Row& row) {
+        switch (spec.ColumnIndex) {
+          case 2: return row.cost->load;
+          case 3: return row.cost->us_per_call;
+          case 4: return static_cast<double>(row.bytes);
+          default: return static_cast<double>(row.node_id.index);
+        }
+      };
+      std::stable_sort(rows.begin(), rows.end(), [&](const Row& a, const Row& b) {
+        if (spec.ColumnIndex == 0) {
+          return spec.SortDirection == ImGuiSortDirection_Ascending ? *a.name < *b.name : *b.name < *a.name;
+        }
+        return spec.SortDirection == ImGuiSortDirection_Ascending ? key(a) < key(b) : key(b) < key(a);
+      });
+    }
+
+    for (const auto& row : rows) {
+      ImGui::TableNextRow();
+      ImGui::TableNextColumn();
+      ImGui::TextUnformatted(row.name->c_str());
+      ImGui::TableNextColumn();
+      ImGui::Text("%u", row.node_id.index);
+      ImGui::TableNextColumn();
+      ImGui::Text("%.2f", row.cost->load * 100);
+      ImGui::TableNextColumn();
+      ImGui::Text("%.2f", row.cost->us_per_call);
+      ImGui::TableNextColumn();
+      ImGui::Text("%zu", row.bytes);
+    }
+    ImGui::EndTable();
+  }
+
+  ImGui::End();
+}
+
 void Gui::ShowContextMenu() {
     auto openPopupPosition = ImGui::GetMousePos();
     auto canvas_pos = ed::ScreenToCanvas(openPopupPosition);
@@ -428,8 +636,8 @@ void Gui::ShowContextMenu() {
                 wrapper.attrs->pos_x = canvas_pos.x;
                 wrapper.attrs->pos_y = canvas_pos.y;
 
-                int new_node_id = graph->GetAccess()->AddNode(wrapper);
-                ed::SetNodePosition(new_node_id, canvas_pos);
+                node_id_t new_node_id = graph->GetAccess()->AddNode(wrapper);
+                ed::SetNodePosition(new_node_id.Pack(), canvas_pos);
               }
             }
             ImGui::EndMenu();
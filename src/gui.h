@@ -1,5 +1,6 @@
 #pragma once
 
+#include <map>
 #include <memory>
 #include <stdio.h>
 
@@ -28,6 +29,15 @@ struct LinkInfo
 };
 
 
+// A node's cost over the last profiling window.
+struct NodeCost {
+  std::uint64_t cycles = 0;  // Counter totals when the window started
+  std::uint64_t calls = 0;
+  double load = 0;           // Fraction of real time spent in the node
+  double us_per_call = 0;
+};
+
+
 class Gui {
  public:
   Gui(
@@ -47,7 +57,10 @@ class Gui {
   void InitWindow();
   void DrawFrame();
   void DrawToolbar();
+  void DrawProfiler();
+  void DrawTelemetry();
   void ShowContextMenu();
+  void UpdateProfile();
 
   SDL_Window* window;
   SDL_GLContext gl_context;
@@ -61,6 +74,17 @@ class Gui {
   ax::NodeEditor::EditorContext* g_Context = nullptr;
   bool g_FirstFrame = true;
 
+  // Profiling window state, refreshed a few times per second of audio.
+  std::map<node_id_t, NodeCost> node_costs;
+  std::uint64_t profile_position = 0;
+  std::uint64_t render_cycles = 0;
+  double dsp_load = 0;
+  bool show_profiler = true;
+
+  // Telemetry counts are shown since this snapshot, taken on reset.
+  TelemetrySnapshot telemetry_base;
+  bool show_telemetry = true;
+
   bool show_demo_window = true;
   bool show_another_window = false;
   ImVec4 clear_color;
@@ -3,22 +3,145 @@
 #include "gui.h"
 #include "node_factory.h"
 #include "audio_thread.h"
+#include "backend.h"
+#include "rtaudio_backend.h"
+#include "patch_file.h"
 
 #include <thread>
 #include <cmath>
+#include <string>
 
-int main() {
-  size_t buf_size = 4000;
+namespace {
+
+void PrintUsage() {
+  std::cout << "Usage: Synth [--threads=N] [--backend=rtaudio|null|file] [--output=FILE] "
+            << "[--mode=push|pull] [--buffer=FRAMES] [--period=FRAMES] [--format=int16|float32] [--dither] "
+            << "[--patch=FILE] [--headless] [--duration=SECONDS]" << std::endl;
+}
+
+void PrintTelemetry(const TelemetrySnapshot& stats) {
+  std::cout << "Periods: " << stats.periods << ", underruns: " << stats.underruns
+            << " (" << stats.missing_frames << " frames of silence), device xruns: " << stats.device_xruns
+            << std::endl;
+  std::cout << "Render time over deadline:";
+  for (std::size_t bin = 0; bin < TelemetrySnapshot::kNumBins; ++bin) {
+    if (stats.deadline_histogram[bin]) {
+      std::cout << " " << TelemetrySnapshot::BinStart(bin) * 100 << "%+: " << stats.deadline_histogram[bin];
+    }
+  }
+  std::cout << ", worst " << stats.worst_load * 100 << "%" << std::endl;
+}
+
+// Falls back to the null backend when there is no sound card, so that the
+// app still starts in containers.
+// The clocked backends always convert to 16 bit.
+std::shared_ptr<OutputBackend> MakeBackend(
+    const std::string& name, const std::string& output_path, std::size_t buf_size, std::size_t period,
+    SampleFormat format, bool dither) {
+  if (name == "rtaudio") {
+    auto backend = std::make_shared<RtAudioBackend>(buf_size, period, format, dither);
+    if (backend->IsOpen()) {
+      return backend;
+    }
+    std::cout << "Can't open audio device, using the null backend" << std::endl;
+    return std::make_shared<NullBackend>(buf_size, period, dither);
+  }
+  if (name == "null") {
+    return std::make_shared<NullBackend>(buf_size, period, dither);
+  }
+  if (name == "file") {
+    auto backend = std::make_shared<FileBackend>(output_path, buf_size, period, dither);
+    if (!backend->IsOpen()) {
+      return nullptr;
+    }
+    return backend;
+  }
+  std::cout << "Unknown backend: " << name << std::endl;
+  return nullptr;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t buf_size = 4000;  // Frames in the ring between the audio thread and the backend, push mode only
+  size_t period = 512;     // Frames per device callback or clocked backend wakeup
+  size_t num_threads = 1;  // Audio rendering threads, 1 disables the worker pool
+  RenderMode mode = RenderMode::kPush;
+  SampleFormat format = SampleFormat::kInt16;
+  bool dither = false;  // TPDF dither when converting to 16 bit
+  std::string backend_name = "rtaudio";
+  std::string output_path = "out.wav";
+  std::string patch_path;
+  bool headless = false;
+  double duration = 10.0;  // Headless only
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg.starts_with("--threads=")) {
+      num_threads = std::max(1, std::stoi(arg.substr(10)));
+    } else if (arg == "--mode=push") {
+      mode = RenderMode::kPush;
+    } else if (arg == "--mode=pull") {
+      mode = RenderMode::kPull;
+    } else if (arg == "--format=int16") {
+      format = SampleFormat::kInt16;
+    } else if (arg == "--format=float32") {
+      format = SampleFormat::kFloat32;
+    } else if (arg == "--dither") {
+      dither = true;
+    } else if (arg.starts_with("--buffer=")) {
+      buf_size = std::max(1, std::stoi(arg.substr(9)));
+    } else if (arg.starts_with("--period=")) {
+      period = std::max(1, std::stoi(arg.substr(9)));
+    } else if (arg.starts_with("--backend=")) {
+      backend_name = arg.substr(10);
+    } else if (arg.starts_with("--output=")) {
+      output_path = arg.substr(9);
+    } else if (arg.starts_with("--patch=")) {
+      patch_path = arg.substr(8);
+    } else if (arg == "--headless") {
+      headless = true;
+    } else if (arg.starts_with("--duration=")) {
+      duration = std::stod(arg.substr(11));
+    } else {
+      std::cout << "Unknown argument: " << arg << std::endl;
+      PrintUsage();
+      return 1;
+    }
+  }
+
+  // Clocked backends read at most a period from the ring.
+  buf_size = std::max(buf_size, period);
+  auto backend = MakeBackend(backend_name, output_path, buf_size, period, format, dither);
+  if (!backend) {
+    PrintUsage();
+    return 1;
+  }
+  std::cout << "Audio backend: " << backend->GetName() << std::endl;
 
   auto graph = std::make_shared<Multigraph>();
-  auto rt_output = std::make_shared<RtAudioOutputHandler>(buf_size);
-  auto audio_thread = std::make_shared<AudioThread>(rt_output, graph);
+  auto audio_thread = std::make_shared<AudioThread>(backend, graph, num_threads, mode);
   auto factory = std::make_shared<NodeFactory>(Context{audio_thread->GetOutput()});
-  
+
+  // JSON or binary.
+  if (!patch_path.empty() && !LoadPatchFile(*graph, patch_path, *factory)) {
+    std::cout << "Invalid patch " << patch_path << std::endl;
+    return 1;
+  }
+
+  if (headless) {
+    audio_thread->Start();
+    std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+    audio_thread->Stop();
+
+    PrintTelemetry(backend->GetTelemetry().GetSnapshot());
+    return 0;
+  }
+
   auto gui = Gui(graph, factory, audio_thread);
-  
+
   audio_thread->Start();
   gui.Spin();
 
   return 0;
-}
\ No newline at end of file
+}
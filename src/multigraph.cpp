@@ -1,89 +1,128 @@
 #include "multigraph.h"
 
-#include <algorithm>
-#include <cstdint>
 #include <map>
+#include <set>
 #include <vector>
-#include <stack>
 
-using Edges = std::vector<std::set<int>>;
+void Multigraph::DisconnectLink(link_id_t link_id) {
+  auto link_pins = links.link_id_to_pins.Get(link_id);
+  auto src_pin = pins.GetPinById(link_pins.first);
+  auto dst_pin = pins.GetPinById(link_pins.second);
 
-std::vector<int> TopologicalSort(int num_vertices, const Edges& edges) {
-  std::vector<std::uint8_t> visited(num_vertices, 0);
-  
-  // false == regular node, true == finished processing children for this node.
-  std::stack<std::pair<int, bool>> nodes;
-  std::vector<int> order;
-  order.reserve(num_vertices);
-
-  for (int i = 0; i < num_vertices; ++i) {
-    if (visited[i]) {
-      continue;
-    }
+  auto dst_node = GetNodeById(dst_pin->node_id);
+  auto dst_input = dst_node->GetInputByIndex(dst_pin->node_io_id);
 
-    nodes.push(std::make_pair(i, false));
+  dst_input->Disconnect();
+  order.RemoveEdge(ToVertex(src_pin->node_id), ToVertex(dst_pin->node_id));
+  links.RemoveLink(link_id);
+}
 
-    while (!nodes.empty()) {
-      auto [s, flag] = nodes.top();
-      nodes.pop();
-      
-      if (flag) {
-        order.push_back(s);
-        continue;
-      }
+bool Multigraph::AddBatch(const GraphBatch& batch, std::vector<node_id_t>* new_ids) {
+  const auto& staged = batch.nodes;
+  const std::size_t num_nodes = staged.size();
+
+  // Validate everything before touching the graph.
+  std::vector<std::vector<std::size_t>> successors(num_nodes);
+  std::vector<std::size_t> num_predecessors(num_nodes, 0);
+  std::set<std::pair<std::size_t, int>> linked_inputs;
+  for (const auto& link : batch.links) {
+    REQ_CHECK_EX(link.src < num_nodes && link.dst < num_nodes, "AddBatch: Node index");
+    REQ_CHECK_EX(link.src != link.dst, "AddBatch: Cycle");
+
+    const auto& node_src = staged[link.src].node;
+    const auto& node_dst = staged[link.dst].node;
+    REQ_CHECK_EX(link.out_idx >= 0 && link.out_idx < static_cast<int>(node_src->NumOutputs()), "AddBatch: Output index");
+    REQ_CHECK_EX(link.in_idx >= 0 && link.in_idx < static_cast<int>(node_dst->NumInputs()), "AddBatch: Input index");
+
+    auto src_out = node_src->GetOutputByIndex(link.out_idx);
+    auto dst_in = node_dst->GetInputByIndex(link.in_idx);
+    REQ_CHECK_EX(src_out->type == dst_in->type, "AddBatch: Type mismatch");
+    REQ_CHECK_EX(!dst_in->IsConnected() && linked_inputs.insert({link.dst, link.in_idx}).second,
+                 "AddBatch: Already connected");
+
+    successors[link.src].push_back(link.dst);
+    ++num_predecessors[link.dst];
+  }
 
-      if (!visited[s]) {
-        visited[s] = true;
-      }
-      
-      nodes.push(std::make_pair(s, true));
-      for (const auto& adjacent : edges[s]) {
-        if (!visited[adjacent]) {
-          nodes.push(std::make_pair(adjacent, false));
-        }
+  // Kahn's algorithm, nodes left out are on a cycle.
+  std::vector<std::size_t> sorted;
+  sorted.reserve(num_nodes);
+  for (std::size_t i = 0; i < num_nodes; ++i) {
+    if (num_predecessors[i] == 0) {
+      sorted.push_back(i);
+    }
+  }
+  for (std::size_t i = 0; i < sorted.size(); ++i) {
+    for (auto next : successors[sorted[i]]) {
+      if (--num_predecessors[next] == 0) {
+        sorted.push_back(next);
       }
     }
   }
-  
-  std::reverse(order.begin(), order.end());
-  return order;
+  REQ_CHECK_EX(sorted.size() == num_nodes, "AddBatch: Cycle");
+
+  // Commit. Ids follow the batch, the order follows the sort so that
+  // every edge below agrees with it and is added in O(1).
+  std::vector<node_id_t> ids(num_nodes);
+  nodes.reserve(nodes.size() + num_nodes);
+  for (std::size_t i = 0; i < num_nodes; ++i) {
+    ids[i] = nodes.Insert(staged[i]);
+    pins.CreatePins(staged[i].node, ids[i]);
+  }
+  for (auto i : sorted) {
+    order.AddVertex(ToVertex(ids[i]));
+  }
+
+  for (const auto& link : batch.links) {
+    auto pin_src = pins.GetNodePins(ids[link.src]).outputs[link.out_idx];
+    auto pin_dst = pins.GetNodePins(ids[link.dst]).inputs[link.in_idx];
+    link_id_t link_id;
+    bool added = links.AddLink(pin_src, pin_dst, &link_id);
+    ASSERT(added);
+
+    auto dst_in = staged[link.dst].node->GetInputByIndex(link.in_idx);
+    dst_in->Connect(staged[link.src].node->GetOutputByIndex(link.out_idx));
+    added = order.AddEdge(ToVertex(ids[link.src]), ToVertex(ids[link.dst]));
+    ASSERT(added);
+  }
+
+  PublishPlan();
+  if (new_ids) {
+    *new_ids = std::move(ids);
+  }
+  return true;
 }
 
+void Multigraph::PublishPlan() {
+  nodes_ordered.clear();
+  nodes_ordered.reserve(nodes.size());
+  order.ForEach([this] (TopologicalOrder::Vertex v) {
+    nodes_ordered.push_back(GetNodeById(nodes.IdAt(v)));
+  });
+
+  // Changes already queued may target nodes only the old plan keeps alive.
+  plan.Publish(std::make_unique<ExecutionPlan>(nodes_ordered), param_queue.NumPushed());
+  CollectGarbage();
+}
 
-void Multigraph::SortNodes() {
-  // Map nodes to simple 1->N index
-  std::map<Node*, int> node_index;
-  std::vector<Node*> nodes_list;
-  int index = 0;
-  nodes_list.reserve(nodes.size());
-  for (auto& [_, wrapper] : nodes) {
-    Node* node_ptr = wrapper.node.get();
-    node_index[node_ptr] = index++;
-    nodes_list.push_back(node_ptr);
+PatchMemory GetPatchMemory(const Multigraph& g) {
+  PatchMemory memory;
+  auto& pins = g.GetPins();
+  memory.num_nodes = g.GetNodes().size();
+  memory.graph_bytes = g.GetNodes().MemoryUsage() + pins.pin_info.MemoryUsage() +
+                       g.GetLinks().link_id_to_pins.MemoryUsage();
+
+  for (auto& [node_id, wrapper] : g.GetNodes()) {
+    memory.node_bytes += wrapper.node->GetMemoryUsage();
   }
-    
-  // Fill edges
-  Edges edges(nodes.size());
-  for (auto& [_, wrapper] : nodes) {
-    Node* node_ptr = wrapper.node.get();
-    int right_idx = node_index[node_ptr];
-    for (size_t input_idx = 0; input_idx < node_ptr->NumInputs(); ++input_idx) {
-      auto input = node_ptr->GetInputByIndex(input_idx);
-      if (input->connection) {
-        Node* left_node = input->connection->parent;
-        int left_idx = node_index[left_node];
-        edges[left_idx].insert(right_idx);
-      }
-    }
+  for (auto& [pin_id, info] : pins.pin_info) {
+    memory.graph_bytes += info.links.capacity() * sizeof(link_id_t);
   }
-  
-  // Topological sort
-  auto order = TopologicalSort(nodes.size(), edges);
-  
-  nodes_ordered.resize(nodes.size());
-  for (int i = 0; i < nodes_list.size(); ++i) {
-    nodes_ordered[i] = nodes_list[order[i]];
+  for (auto& node_pins : pins.node_to_pins) {
+    memory.graph_bytes += sizeof(NodePins) +
+      (node_pins.inputs.capacity() + node_pins.outputs.capacity()) * sizeof(pin_id_t);
   }
+  return memory;
 }
 
 void SaveGraph(const Multigraph& g, nlohmann::json& j) {
@@ -97,7 +136,7 @@ void SaveGraph(const Multigraph& g, nlohmann::json& j) {
 
   for (auto& [node_id, wrapper] : g.GetNodes()) {
     auto j_node = json::object();
-    j_node["id"] = node_id;
+    j_node["id"] = node_id.index;
     j_node["type"] = names.GetName(wrapper.node->GetType());
     j_node["params"] = json::object();
     j_node["attributes"] = json::object();
@@ -111,15 +150,16 @@ void SaveGraph(const Multigraph& g, nlohmann::json& j) {
     auto pin_dst = pins.GetPinById(link_pins.second);
     
     j_links.push_back(json::array({
-      pin_src->node_id, pin_src->node_io_id, 
-      pin_dst->node_id, pin_dst->node_io_id}));
+      pin_src->node_id.index, pin_src->node_io_id, 
+      pin_dst->node_id.index, pin_dst->node_io_id}));
   }
 }
 
-void LoadGraph(Multigraph& g, const nlohmann::json& j, const NodeFactory& factory) {
+bool LoadGraph(Multigraph& g, const nlohmann::json& j, const NodeFactory& factory) {
   NodeNames names;
 
-  std::map<int, int> node_old_to_new;
+  GraphBatch batch;
+  std::map<int, std::size_t> node_old_to_batch;
 
   auto& j_nodes = JsonGetConstRef(j, "nodes");
   ASSERT(j_nodes.is_array());
@@ -136,22 +176,20 @@ void LoadGraph(Multigraph& g, const nlohmann::json& j, const NodeFactory& factor
     wrapper.attrs->is_placed = false;
     wrapper.attrs->Load(JsonGetConstRef(j_node, "attributes"));
 
-    int new_id = g.AddNode(wrapper);
-    node_old_to_new[old_id] = new_id;
+    node_old_to_batch[old_id] = batch.AddNode(wrapper);
   }
   
   auto& j_links = JsonGetConstRef(j, "links");
-  ASSERT(j_nodes.is_array());
+  ASSERT(j_links.is_array());
   for (auto& j_link : j_links) {
     ASSERT(j_link.is_array());
-    int new_link_id = 0;
-    g.AddLink(
-      /*src*/MapGetRef(node_old_to_new, j_link.at(0).get<int>()),
+    batch.AddLink(
+      /*src*/MapGetRef(node_old_to_batch, j_link.at(0).get<int>()),
       /*out_idx*/j_link.at(1).get<int>(),
-      /*dst*/MapGetRef(node_old_to_new, j_link.at(2).get<int>()),
-      /*in_idx*/j_link.at(3).get<int>(),
-      &new_link_id,
-      /*commit=*/true
+      /*dst*/MapGetRef(node_old_to_batch, j_link.at(2).get<int>()),
+      /*in_idx*/j_link.at(3).get<int>()
     );
   }
+
+  return g.AddBatch(batch);
 }
\ No newline at end of file
@@ -2,11 +2,14 @@
 
 #include <vector>
 #include <map>
-#include <set>
 #include <mutex>
 
+#include "execution_plan.h"
 #include "node.h"
 #include "node_factory.h"
+#include "slot_map.h"
+#include "snapshot.h"
+#include "topological_order.h"
 #include "util.h"
 
 #include "json.hpp"
@@ -23,19 +26,22 @@ struct Access {
 
 enum class PinType { kInput, kOutput };
 
-// Crutch to have "unique" ids for nodes, links and pins
-const int kPinIdOffset = 100000;
-const int kLinkIdOffset = 200000;
+// Node editor ids are packed handles, the kind keeps them unique across
+// nodes, pins and links.
+struct NodeTag { static constexpr std::uint8_t kKind = 1; };
+struct PinTag { static constexpr std::uint8_t kKind = 2; };
+struct LinkTag { static constexpr std::uint8_t kKind = 3; };
 
-using node_id_t = int;
-using link_id_t = int;
-using pin_id_t = int;
+using node_id_t = Handle<NodeTag>;
+using link_id_t = Handle<LinkTag>;
+using pin_id_t = Handle<PinTag>;
 
 
 struct PinInfo {
   PinType type;
   node_id_t node_id;
   int node_io_id;  // Sequential input or output id
+  std::vector<link_id_t> links;  // Links at this pin, at most one for inputs of a Multigraph
 };
 
 struct NodePins {
@@ -64,139 +70,173 @@ struct NodeWrapper {
   std::shared_ptr<NodeAttributes> attrs;
 };
 
-using Nodes = std::map<node_id_t, NodeWrapper>;
+using Nodes = SlotMap<NodeWrapper, NodeTag>;
 
 struct Pins {
   void CreatePins(const NodePtr& node, node_id_t node_id) {
-    ASSERT(!node_to_pins.contains(node_id));
-    auto& node_pins = node_to_pins[node_id];
+    if (node_to_pins.size() <= node_id.index) {
+      node_to_pins.resize(node_id.index + 1);
+    }
+    auto& node_pins = node_to_pins[node_id.index];
+    ASSERT(node_pins.inputs.empty() && node_pins.outputs.empty());
 
     for (int i = 0; i < node->NumInputs(); ++i) {
-      int pin_id = pin_counter++;
-      MapInsert(pin_info, pin_id, PinInfo{
+      node_pins.inputs.push_back(pin_info.Insert(PinInfo{
         .type = PinType::kInput,
         .node_id = node_id,
-        .node_io_id = i});
-      node_pins.inputs.push_back(pin_id);
+        .node_io_id = i}));
     }
 
     for (int i = 0; i < node->NumOutputs(); ++i) {
-      int pin_id = pin_counter++;
-      MapInsert(pin_info, pin_id, PinInfo{
+      node_pins.outputs.push_back(pin_info.Insert(PinInfo{
         .type = PinType::kOutput,
         .node_id = node_id,
-        .node_io_id = i});
-      node_pins.outputs.push_back(pin_id);
+        .node_io_id = i}));
     }
   }
   
   void RemoveNodePins(node_id_t node_id) {
-    auto& node_pins = MapGetRef(node_to_pins, node_id);
+    auto& node_pins = node_to_pins[node_id.index];
     for (auto pin_id : node_pins.inputs) {
-      MapErase(pin_info, pin_id);
+      pin_info.Erase(pin_id);
     }
 
     for (auto pin_id : node_pins.outputs) {
-      MapErase(pin_info, pin_id);
+      pin_info.Erase(pin_id);
     }
     
-    MapErase(node_to_pins, node_id);
+    node_pins = {};
   }
   
   const PinInfo* GetPinById(pin_id_t pin_id) const {
-    return &MapGetConstRef(pin_info, pin_id);
+    return &pin_info.Get(pin_id);
+  }
+
+  PinInfo* GetPinById(pin_id_t pin_id) {
+    return &pin_info.Get(pin_id);
   }
   
   node_id_t GetNodeFromPin(pin_id_t pin_id) const {
-    auto& info = MapGetConstRef(pin_info, pin_id);
-    return info.node_id;
+    return pin_info.Get(pin_id).node_id;
   }
 
-  std::map<pin_id_t, PinInfo> pin_info;  
-  std::map<node_id_t, NodePins> node_to_pins;
-  
- private:
-  pin_id_t pin_counter = kPinIdOffset;
+  // Node has to be live.
+  const NodePins& GetNodePins(node_id_t node_id) const {
+    return node_to_pins[node_id.index];
+  }
+
+  SlotMap<PinInfo, PinTag> pin_info;
+  std::vector<NodePins> node_to_pins;  // By node slot index
 };
 
 struct Links {
-  Links(const Pins* pins) : pins(pins) { }
+  Links(Pins* pins) : pins(pins) { }
   
   bool CanAddLink(pin_id_t pin_src, pin_id_t pin_dst) {
     return AddLink(pin_src, pin_dst, nullptr, /*commit=*/false);
   }
 
   bool AddLink(pin_id_t pin_src, pin_id_t pin_dst, link_id_t* new_link_id, bool commit=true) {
-    auto pin_pair = std::make_pair(pin_src, pin_dst);
-    REQ_CHECK_EX(!pins_to_link_id.contains(pin_pair), "Pin pair already exists");
+    REQ_CHECK_EX(!LinkExists(pin_src, pin_dst), "Pin pair already exists");
 
-    int node_src = pins->GetNodeFromPin(pin_src);
-    int node_dst = pins->GetNodeFromPin(pin_dst);
+    auto info_src = pins->GetPinById(pin_src);
+    auto info_dst = pins->GetPinById(pin_dst);
 
-    REQ_CHECK(node_src != node_dst);
+    REQ_CHECK(info_src->node_id != info_dst->node_id);
     if (!commit) {
       return true;
     }
 
     // Commit
-    link_id_t id = link_counter++;
-    pins_to_link_id[pin_pair] = id;
-    link_id_to_pins[id] = pin_pair;
-
-    node_links[node_src].insert(id);
-    node_links[node_dst].insert(id);
+    link_id_t id = link_id_to_pins.Insert(std::make_pair(pin_src, pin_dst));
+    info_src->links.push_back(id);
+    info_dst->links.push_back(id);
 
     *new_link_id = id;
     return true;
   }
   
   void RemoveLink(link_id_t link_id) {
-    auto link_pins = MapGetRef(link_id_to_pins, link_id);
+    auto link_pins = link_id_to_pins.Get(link_id);
+    link_id_to_pins.Erase(link_id);
 
-    MapErase(pins_to_link_id, link_pins);
-    MapErase(link_id_to_pins, link_id);
-    
-    // Find node ids for src and dst pins
-    node_id_t node_src = pins->GetNodeFromPin(link_pins.first);
-    node_id_t node_dst = pins->GetNodeFromPin(link_pins.second);
-    
-    SetErase(node_links[node_src], link_id);
-    SetErase(node_links[node_dst], link_id);
+    std::erase(pins->GetPinById(link_pins.first)->links, link_id);
+    std::erase(pins->GetPinById(link_pins.second)->links, link_id);
   }
   
-  bool LinkExists(int pin_src, int pin_dst) const {
-    auto pin_pair = std::make_pair(pin_src, pin_dst);
-    return pins_to_link_id.contains(pin_pair);
+  bool LinkExists(pin_id_t pin_src, pin_id_t pin_dst) const {
+    for (auto link_id : pins->GetPinById(pin_dst)->links) {
+      if (link_id_to_pins.Get(link_id).first == pin_src) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Any links at the pins of node
+  std::vector<link_id_t> GetNodeLinks(node_id_t node_id) const {
+    std::vector<link_id_t> node_links;
+    auto add_links = [&] (const std::vector<pin_id_t>& pin_ids) {
+      for (auto pin_id : pin_ids) {
+        auto& pin_links = pins->GetPinById(pin_id)->links;
+        node_links.insert(node_links.end(), pin_links.begin(), pin_links.end());
+      }
+    };
+    auto& node_pins = pins->GetNodePins(node_id);
+    add_links(node_pins.inputs);
+    add_links(node_pins.outputs);
+    return node_links;
   }
 
-  std::map<link_id_t, std::pair<pin_id_t, pin_id_t>> link_id_to_pins;  
-  std::map<std::pair<pin_id_t, pin_id_t>, link_id_t> pins_to_link_id;
-  std::map<node_id_t, std::set<link_id_t>> node_links;  // Any links associated with node
+  SlotMap<std::pair<pin_id_t, pin_id_t>, LinkTag> link_id_to_pins;
   
  private:
-  link_id_t link_counter = kLinkIdOffset;
-  const Pins* pins;
+  Pins* pins;
+};
+
+// Nodes and links added to a graph in one go by Multigraph::AddBatch().
+// Links refer to nodes by their index in the batch.
+struct GraphBatch {
+  struct Link {
+    std::size_t src;
+    int out_idx;
+    std::size_t dst;
+    int in_idx;
+  };
+
+  std::size_t AddNode(NodeWrapper wrapper) {
+    nodes.push_back(std::move(wrapper));
+    return nodes.size() - 1;
+  }
+
+  void AddLink(std::size_t src, int out_idx, std::size_t dst, int in_idx) {
+    links.push_back({src, out_idx, dst, in_idx});
+  }
+
+  std::vector<NodeWrapper> nodes;
+  std::vector<Link> links;
 };
 
 
 class Multigraph {
  public:
-  Multigraph() : links(&pins) { }
+  Multigraph() : links(&pins) {
+    PublishPlan();
+  }
   
-  int AddNode(NodeWrapper wrapper) {
-    int new_id = id_counter++;
-    ASSERT(!nodes.contains(new_id));
-    nodes[new_id] = wrapper;
+  node_id_t AddNode(NodeWrapper wrapper) {
+    node_id_t new_id = nodes.Insert(wrapper);
     pins.CreatePins(wrapper.node, new_id);
-    SortNodes();
+    order.AddVertex(ToVertex(new_id));
+    PublishPlan();
     return new_id;
   }
   
-  bool CanAddLink(int pin_id_src, int pin_id_dst) {
+  bool CanAddLink(pin_id_t pin_id_src, pin_id_t pin_id_dst) {
     return AddLink(pin_id_src, pin_id_dst, nullptr, false);
   }
   
-  bool AddLink(int pin_id_src, int pin_id_dst, int* new_link_id, bool commit=true) {
+  bool AddLink(pin_id_t pin_id_src, pin_id_t pin_id_dst, link_id_t* new_link_id, bool commit=true) {
     REQ_CHECK_EX(!links.LinkExists(pin_id_src, pin_id_dst), "Link exists");
 
     auto pin_src = pins.GetPinById(pin_id_src);
@@ -214,6 +254,7 @@ class Multigraph {
     
     // Additional requirement: input can only have one link
     REQ_CHECK_EX(!dst_in->IsConnected(), "Already connected");
+    REQ_CHECK_EX(!order.WouldCreateCycle(ToVertex(pin_src->node_id), ToVertex(pin_dst->node_id)), "AddLink: Cycle");
     REQ_CHECK_EX(links.AddLink(pin_id_src, pin_id_dst, new_link_id, commit), "Failed to add link");
     
     if (!commit) {
@@ -221,47 +262,49 @@ class Multigraph {
     }
 
     dst_in->Connect(src_out);
-    SortNodes();
+    bool added = order.AddEdge(ToVertex(pin_src->node_id), ToVertex(pin_dst->node_id));
+    ASSERT(added);
+    PublishPlan();
     return true;
   }
   
-  bool AddLink(node_id_t node_id_src, int out_idx_src, node_id_t node_id_dst, int in_idx_dst, int* new_link_id, bool commit) {
+  bool AddLink(node_id_t node_id_src, int out_idx_src, node_id_t node_id_dst, int in_idx_dst, link_id_t* new_link_id, bool commit) {
     REQ_CHECK(node_id_src != node_id_dst);
-    auto& pins_src = MapGetRef(pins.node_to_pins, node_id_src);
-    auto& pins_dst = MapGetRef(pins.node_to_pins, node_id_dst);
+    ASSERT(nodes.Contains(node_id_src) && nodes.Contains(node_id_dst));
+    auto& pins_src = pins.GetNodePins(node_id_src);
+    auto& pins_dst = pins.GetNodePins(node_id_dst);
     ASSERT(out_idx_src < pins_src.outputs.size());
     ASSERT(in_idx_dst < pins_dst.inputs.size());
     
     return AddLink(pins_src.outputs[out_idx_src], pins_dst.inputs[in_idx_dst], new_link_id, commit);
   }
   
-  void RemoveNode(int node_id) {
-    ASSERT(nodes.contains(node_id));
-    std::set<int> node_links = links.node_links[node_id];
-    for (auto link_id : node_links) {
-      RemoveLink(link_id);
+  void RemoveNode(node_id_t node_id) {
+    ASSERT(nodes.Contains(node_id));
+    for (auto link_id : links.GetNodeLinks(node_id)) {
+      DisconnectLink(link_id);
     }
 
-    links.node_links.erase(node_id);
     pins.RemoveNodePins(node_id);
-    nodes.erase(node_id);
-    SortNodes();
+    nodes.Erase(node_id);
+    order.RemoveVertex(ToVertex(node_id));
+    PublishPlan();
   }
   
-  void RemoveLink(int link_id) {
-    auto& link_pins = MapGetRef(links.link_id_to_pins, link_id);
-    auto dst_pin = pins.GetPinById(link_pins.second);
-
-    auto dst_node = GetNodeById(dst_pin->node_id);
-    auto dst_input = dst_node->GetInputByIndex(dst_pin->node_io_id);
-
-    dst_input->Disconnect();
-    links.RemoveLink(link_id);
-    SortNodes();
+  void RemoveLink(link_id_t link_id) {
+    DisconnectLink(link_id);
+    PublishPlan();
   }
 
-  NodePtr& GetNodeById(int node_id) {
-    return MapGetRef(nodes, node_id).node;
+  // Adds all of the batch or, if any link is invalid or they close a
+  // cycle, nothing. Validates and sorts the batch on its own, then
+  // publishes one plan: linear in the size of the batch, where adding the
+  // same one edit by edit compiles a plan for each. Node ids go to
+  // new_ids in batch order.
+  bool AddBatch(const GraphBatch& batch, std::vector<node_id_t>* new_ids = nullptr);
+
+  NodePtr& GetNodeById(node_id_t node_id) {
+    return nodes.Get(node_id).node;
   }
   
   const Nodes& GetNodes() const { return nodes; }
@@ -271,26 +314,65 @@ class Multigraph {
   const Links& GetLinks() const { return links; }
   
   auto& GetSortedNodes() { return nodes_ordered; }
+
+  const TopologicalOrder& GetOrder() const { return order; }
+
+  // Compiled form of the sorted nodes, republished on every topology change.
+  // Audio thread only, never blocks on graph edits.
+  auto AcquirePlan() { return plan.Acquire(); }
+
+  // Parameter edits of the graph nodes, pushed by GUI, applied by audio thread.
+  ParamQueue& GetParamQueue() { return param_queue; }
+
+  // GUI thread. Frees plans the audio thread no longer uses.
+  void CollectGarbage() {
+    plan.Collect(param_queue.NumApplied());
+  }
   
-  // Used for concurrent ops between GUI and audio thread
+  // Serializes graph edits. The audio thread doesn't take it.
   Access<Multigraph> GetAccess() {
     return {this, std::lock_guard(_mtx)};
   }
 
  private:
-  void SortNodes();
+  // Removes the link without republishing the plan.
+  void DisconnectLink(link_id_t link_id);
 
-  std::vector<Node*> nodes_ordered;  // Ordered for processing
+  // The order works on node slot indices, live nodes never share one.
+  static TopologicalOrder::Vertex ToVertex(node_id_t node_id) {
+    return static_cast<TopologicalOrder::Vertex>(node_id.index);
+  }
+
+  // Compiles the current order into a new plan for the audio thread.
+  void PublishPlan();
+
+  TopologicalOrder order;  // Of node slot indices, updated on every edit
+  std::vector<NodePtr> nodes_ordered;  // Ordered for processing
+  SnapshotCell<ExecutionPlan> plan;
+  ParamQueue param_queue;
 
   Nodes nodes;  // Node id to node
   Pins pins;
   Links links;
-
-  int id_counter = 1;
   
   mutable std::mutex _mtx;
 };
 
 
+// What a patch takes in memory, see GetPatchMemory().
+struct PatchMemory {
+  std::size_t num_nodes = 0;
+  std::size_t node_bytes = 0;  // Sum of Node::GetMemoryUsage()
+  std::size_t graph_bytes = 0;  // Node, pin and link tables of the graph
+
+  std::size_t BytesPerNode() const {
+    return num_nodes ? (node_bytes + graph_bytes) / num_nodes : 0;
+  }
+};
+
+PatchMemory GetPatchMemory(const Multigraph& g);
+
 void SaveGraph(const Multigraph& g, nlohmann::json& j);
-void LoadGraph(Multigraph& g, const nlohmann::json& j, const NodeFactory& factory);
\ No newline at end of file
+// Adds the nodes and links of j to g as one batch. Returns false and
+// leaves g unchanged if they don't make a valid graph.
+bool LoadGraph(Multigraph& g, const nlohmann::json& j, const NodeFactory& factory);
\ No newline at end of file
@@ -1,15 +1,21 @@
 #pragma once
 
+#include <cstdint>
 #include <vector>
 #include <variant>
 #include <iostream>
 #include <optional>
 #include <memory>
+#include <memory_resource>
 #include <string>
 #include <map>
 
+#include "arena.h"
 #include "note.h"
 #include "node_types.h"
+#include "output.h"
+#include "param.h"
+#include "profiler.h"
 #include "util.h"
 
 #include "json.hpp"
@@ -21,6 +27,16 @@ enum class PinDataType {
   kChannel
 };
 
+// How often the value of an output may change. Control-rate nodes run once
+// per block on a single sample, only the first element of their output
+// buffers is valid. Audio-rate inputs see them through a ramp, so only
+// outputs that follow parameter edits should be control rate, never
+// events that have to land on a sample.
+enum class PinRate {
+  kControl,
+  kAudio
+};
+
 using PinData = std::variant<
   int, 
   float,
@@ -28,6 +44,46 @@ using PinData = std::variant<
   Channel
 >;
 
+// Position of a block on the timeline.
+struct BlockInfo {
+  std::uint64_t position = 0;  // Sample clock of the first sample, never wraps.
+  float time = 0.0f;      // Timestamp of the first sample, wraps like SampleWriter::GetTimestamp.
+  float dt = 0.0f;        // Time between two consecutive samples.
+  std::size_t size = 0;   // Number of samples, never above kMaxBlockSize.
+
+  float TimeAt(std::size_t idx) const {
+    return time + idx * dt;
+  }
+
+  std::uint64_t PositionAt(std::size_t idx) const {
+    return position + idx;
+  }
+};
+
+// Raw pin buffers of a node for one block, in the order of its inputs and outputs.
+// Every buffer holds kMaxBlockSize elements of the pin data type.
+// Unconnected inputs point to a block filled with the default value.
+// Buffers are owned by the ExecutionPlan.
+struct BlockIO {
+  const void* const* inputs = nullptr;
+  void* const* outputs = nullptr;
+  const std::uint8_t* connected = nullptr;  // Per input
+
+  template <typename T>
+  const T* In(std::size_t idx) const {
+    return static_cast<const T*>(inputs[idx]);
+  }
+
+  template <typename T>
+  T* Out(std::size_t idx) const {
+    return static_cast<T*>(outputs[idx]);
+  }
+
+  bool IsConnected(std::size_t idx) const {
+    return connected[idx];
+  }
+};
+
 class Node;
 using NodePtr = std::shared_ptr<Node>;
 
@@ -47,18 +103,21 @@ struct Output : public Connection {
       : Connection(name, type, parent)
       , value(default_value) { }
   PinData value;
+  // Fastest rate the output runs at. Pure nodes drop to control rate
+  // when all their inputs are at control rate.
+  PinRate rate = PinRate::kAudio;
 
   template <typename T> 
   T GetValue() const {
     const T* t_ptr = std::get_if<T>(&value);
-    ASSERT(t_ptr);
+    HOT_ASSERT(t_ptr);
     return *t_ptr;
   }
 
   template <typename T> 
   T& GetValue() {
     T* t_ptr = std::get_if<T>(&value);
-    ASSERT(t_ptr);
+    HOT_ASSERT(t_ptr);
     return *t_ptr;
   }
 
@@ -71,26 +130,41 @@ struct Output : public Connection {
   bool IsT() const {
     return std::holds_alternative<T>(value);
   }
+
+  // Copies current value into the idx-th element of a block buffer.
+  void StoreSample(void* buffer, std::size_t idx) const {
+    std::visit([&] (const auto& v) {
+      using T = std::decay_t<decltype(v)>;
+      static_cast<T*>(buffer)[idx] = v;
+    }, value);
+  }
 };
 
 struct Input : public Connection {
   Input(const std::string& name, PinDataType type, Node* parent, PinData default_value)
       : Connection(name, type, parent)
-      , default_value(default_value) { 
+      , default_value(default_value)
+      , value(default_value) { 
   }
 
-  std::shared_ptr<Output> connection;
+  Output* connection = nullptr;  // Lives in the producing node
   PinData default_value;
+  PinData value;  // Current sample, filled by the per-sample adapter.
 
   template <typename T>
   T GetValue() const {
-    if (connection && connection->IsT<T>()) {
-      return connection->GetValue<T>();
-    }
-    return std::get<T>(default_value);
+    return std::get<T>(value);
+  }
+
+  // Loads the idx-th element of a block buffer as the current value.
+  void LoadSample(const void* buffer, std::size_t idx) {
+    std::visit([&] (auto& v) {
+      using T = std::decay_t<decltype(v)>;
+      v = static_cast<const T*>(buffer)[idx];
+    }, value);
   }
 
-  bool Connect(std::shared_ptr<Output> output) {
+  bool Connect(Output* output) {
     // TODO: after debugging replace asserts with warnings.
     if (parent == output->parent || type != output->type) {
       return false;
@@ -103,12 +177,12 @@ struct Input : public Connection {
     connection = nullptr;
   }
   
-  bool IsConnected(std::shared_ptr<Output> output) const {
+  bool IsConnected(const Output* output) const {
     if (!connection) {
       return false;
     }
 
-    return connection.get() == output.get();
+    return connection == output;
   }
   
   bool IsConnected() const {
@@ -116,8 +190,9 @@ struct Input : public Connection {
   }
 };
 
-using InputPtr = std::shared_ptr<Input>;
-using OutputPtr = std::shared_ptr<Output>;
+// Pins belong to their node and live as long as it does.
+using InputPtr = Input*;
+using OutputPtr = Output*;
 
 
 class Node {
@@ -126,7 +201,7 @@ class Node {
   virtual ~Node() = default;
 
   void Update(std::size_t timestamp) {
-    ASSERT(last_update <= timestamp);
+    HOT_ASSERT(last_update <= timestamp);
     if (last_update != timestamp) {
       Process(timestamp);
     }
@@ -134,8 +209,8 @@ class Node {
 
   InputPtr GetInputByName(const std::string& name) {
     for (auto& input : inputs) {
-      if (input->name == name) {
-        return input;
+      if (input.name == name) {
+        return &input;
       }
     }
 
@@ -145,8 +220,8 @@ class Node {
 
   OutputPtr GetOutputByName(const std::string& name) {
     for (auto& output : outputs) {
-      if (output->name == name) {
-        return output;
+      if (output.name == name) {
+        return &output;
       }
     }
     
@@ -156,12 +231,12 @@ class Node {
   
   InputPtr GetInputByIndex(size_t index) {
     ASSERT(index < inputs.size());
-    return inputs[index];
+    return &inputs[index];
   }
 
   OutputPtr GetOutputByIndex(size_t index) {
     ASSERT(index < outputs.size());
-    return outputs[index];
+    return &outputs[index];
   }
   
   size_t NumInputs() const {
@@ -180,17 +255,88 @@ class Node {
     return type;
   }
 
-  virtual void Process(float time) = 0;
+  // Processes info.size samples at once. Nodes override this with their own
+  // sample loop. The default adapter calls Process() for every sample.
+  virtual void ProcessBlock(const BlockInfo& info, const BlockIO& io) {
+    for (size_t i = 0; i < info.size; ++i) {
+      for (size_t k = 0; k < inputs.size(); ++k) {
+        inputs[k].LoadSample(io.inputs[k], i);
+      }
+
+      Process(info.TimeAt(i));
+
+      for (size_t k = 0; k < outputs.size(); ++k) {
+        outputs[k].StoreSample(io.outputs[k], i);
+      }
+    }
+  }
+
+  // Per-sample processing, only used through the ProcessBlock adapter.
+  virtual void Process(float time) {}
+
+  // Has effects outside of the graph: plays, records or displays its inputs.
+  // Nodes without a path to a sink are not executed.
+  virtual bool IsSink() const {
+    return false;
+  }
+
+  // Outputs depend only on inputs and params: no time, no state, no effects.
+  // Pure nodes fed only by other pure nodes are folded into constants.
+  virtual bool IsPure() const {
+    return false;
+  }
+
+  // What ProcessBlock computes, if it is one elementwise op from its inputs
+  // to its only output. io is as in ProcessBlock, only its connections are
+  // valid.
+  virtual std::optional<ElementwiseOp> GetElementwiseOp(const BlockIO& io) const {
+    return std::nullopt;
+  }
+
   virtual void Draw() {}
   
   virtual void Load(const nlohmann::json& j) {};
   virtual void Save(nlohmann::json& j) const {};
 
+  // GUI thread. Sends parameters edited in Draw() to the audio thread.
+  void FlushParams(ParamQueue& queue, std::uint64_t time) {
+    for (auto param : params) {
+      param->Flush(queue, time);
+    }
+  }
+
+  // Time spent in ProcessBlock, kept by the execution plan.
+  CycleCounter& GetProfile() {
+    return profile;
+  }
+
+  const CycleCounter& GetProfile() const {
+    return profile;
+  }
+
+  // Bytes allocated while the node was constructed by a NodeArena: the
+  // node, its shared_ptr control block and its pins. 0 for nodes made
+  // outside of one.
+  std::size_t GetMemoryUsage() const {
+    return memory_usage;
+  }
+
  protected:
   std::string display_name;
   NodeType type;
   std::size_t last_update = -1;
 
-  std::vector<InputPtr> inputs;
-  std::vector<OutputPtr> outputs;
+  // Added by the constructor of the derived node, never after: links
+  // point into them. In the arena the node is constructed by.
+  std::pmr::vector<Input> inputs{NodeArena::Current()};
+  std::pmr::vector<Output> outputs{NodeArena::Current()};
+
+  // Members edited from Draw(), registered by the derived node.
+  std::vector<ParamBase*> params;
+
+ private:
+  friend class NodeArena;
+
+  CycleCounter profile;
+  std::size_t memory_usage = 0;
 };
\ No newline at end of file
@@ -1,9 +1,8 @@
 #include "node_factory.h"
 
-#include "nodes/osc.h"
-#include "nodes/sink.h"
-#include "nodes/common.h"
-#include "nodes/seq.h"
+#include <type_traits>
+
+#include "node_registry.h"
 
 template <typename T>
 void RegisterDisplayName(std::map<NodeType, std::string>& m) {
@@ -19,25 +18,21 @@ void NodeFactory::RegisterCategories() {
   category_names[NodeCategory::IO] = "I/O";
 }
 
+template <typename T>
+void NodeFactory::Register() {
+  creators[static_cast<std::size_t>(T::TYPE)] = [] (const NodeFactory& factory) -> NodePtr {
+    if constexpr (std::is_constructible_v<T, std::shared_ptr<AudioOutput>>) {
+      return factory.arena->Make<T>(factory.ctx.output);
+    } else {
+      return factory.arena->Make<T>();
+    }
+  };
+  display_names[T::TYPE] = T::DISPLAY_NAME;
+  nodes_by_category[T::CATEGORY].push_back(T::TYPE);
+}
+
 void NodeFactory::RegisterNodes() {
-  RegisterContextNode<AudioOutputNode>(NodeCategory::IO, [this] () -> NodePtr {
-    return std::make_shared<AudioOutputNode>(ctx.output);
+  RegisteredNodes::ForEach([this] <typename T> () {
+    Register<T>();
   });
-  
-  RegisterSimpleNode<SineOscillatorNode>(NodeCategory::OCSILLATOR);
-  RegisterSimpleNode<SquareOscillatorNode>(NodeCategory::OCSILLATOR);
-
-  RegisterSimpleNode<SliderNode>(NodeCategory::UTILITY);
-  RegisterSimpleNode<ConstantNode>(NodeCategory::UTILITY);
-  RegisterSimpleNode<ChannelUnpackNode>(NodeCategory::UTILITY);
-
-  RegisterSimpleNode<AddNode>(NodeCategory::ARITHMETIC);
-  RegisterSimpleNode<MultiplyNode>(NodeCategory::ARITHMETIC);
-  RegisterSimpleNode<NegateNode>(NodeCategory::ARITHMETIC);
-  RegisterSimpleNode<MixNode>(NodeCategory::ARITHMETIC);
-  RegisterSimpleNode<ClampNode>(NodeCategory::ARITHMETIC);
-
-  RegisterSimpleNode<DebugNode>(NodeCategory::DEBUG);
-
-  RegisterSimpleNode<ClockNode>(NodeCategory::SEQUENCER);
-}
\ No newline at end of file
+}
@@ -1,8 +1,9 @@
 #pragma once
 
-#include <functional>
+#include <array>
 #include <map>
 
+#include "arena.h"
 #include "node.h"
 #include "node_types.h"
 #include "output.h"
@@ -11,24 +12,17 @@ struct Context {
   std::shared_ptr<AudioOutput> output;
 };
 
-enum class NodeCategory {
-  OCSILLATOR,
-  SEQUENCER,
-  IO,
-  UTILITY,
-  ARITHMETIC,
-  DEBUG
-};
-
 struct NodeFactory {
   NodeFactory(const Context& ctx) : ctx(ctx) { 
     RegisterCategories();
     RegisterNodes();
   };
 
+  // Nodes are allocated in GetArena(), which they keep alive.
   NodePtr CreateNode(const NodeType& type) const {
-    auto& func = MapGetConstRef(factory, type);
-    return func();
+    auto creator = creators[static_cast<std::size_t>(type)];
+    ASSERT(creator);
+    return creator(*this);
   }
   
   void RegisterCategories();
@@ -45,29 +39,22 @@ struct NodeFactory {
   const auto& GetCategoryNames() const {
     return category_names;
   }
+
+  const NodeArena& GetArena() const {
+    return *arena;
+  }
   
  private:
   template <typename T>
-  void RegisterSimpleNode(NodeCategory category) {
-    factory[T::TYPE] = [] () -> NodePtr {
-      return std::make_shared<T>();
-    };
-    display_names[T::TYPE] = T::DISPLAY_NAME;
-    nodes_by_category[category].push_back(T::TYPE);
-  }
-
-  template <typename T>
-  void RegisterContextNode(NodeCategory category, std::function<NodePtr()> func) {
-    factory[T::TYPE] = func; 
-    display_names[T::TYPE] = T::DISPLAY_NAME;
-    nodes_by_category[category].push_back(T::TYPE);
-  }
+  void Register();
 
-  std::map<NodeType, std::function<NodePtr()>> factory;
+  using Creator = NodePtr (*)(const NodeFactory& factory);
+  std::array<Creator, kNumNodeTypes> creators = {};  // By NodeType, null if not registered
   std::map<NodeType, std::string> display_names;
   std::map<NodeCategory, std::string> category_names;
   std::map<NodeCategory, std::vector<NodeType>> nodes_by_category;
 
   Context ctx;
   NodeNames names;
+  std::shared_ptr<NodeArena> arena = std::make_shared<NodeArena>();
 };
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <typeinfo>
+
+#include "node.h"
+#include "node_types.h"
+
+#include "nodes/osc.h"
+#include "nodes/sink.h"
+#include "nodes/common.h"
+#include "nodes/seq.h"
+
+// Node classes known at compile time. The factory creates nodes from the
+// list and the execution plan calls ProcessBlock of the exact class, which
+// inlines the node's loop instead of going through the vtable. Editor code
+// keeps using the virtual Node interface.
+template <typename... Ts>
+struct NodeList {
+  static constexpr std::size_t kSize = sizeof...(Ts);
+
+  // Calls f.template operator()<T>() for every class T, in list order.
+  template <typename F>
+  static void ForEach(F&& f) {
+    (f.template operator()<Ts>(), ...);
+  }
+
+  // Index of the exact class of node, kSize for any class not listed.
+  static std::size_t IndexOf(const Node& node) {
+    const std::type_info* types[] = {&typeid(Ts)...};
+    for (std::size_t i = 0; i < kSize; ++i) {
+      if (typeid(node) == *types[i]) {
+        return i;
+      }
+    }
+    return kSize;
+  }
+
+  static constexpr bool HasUniqueTypes() {
+    NodeType types[] = {Ts::TYPE...};
+    for (std::size_t i = 0; i < kSize; ++i) {
+      for (std::size_t j = i + 1; j < kSize; ++j) {
+        if (types[i] == types[j]) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+};
+
+// In the order the editor lists them within a category.
+using RegisteredNodes = NodeList<
+  AudioOutputNode,
+  SineOscillatorNode,
+  SquareOscillatorNode,
+  SliderNode,
+  ConstantNode,
+  ChannelUnpackNode,
+  AddNode,
+  MultiplyNode,
+  NegateNode,
+  MixNode,
+  ClampNode,
+  DebugNode,
+  ClockNode
+>;
+
+static_assert(RegisteredNodes::HasUniqueTypes(), "Two node classes share a NodeType");
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <map>
 #include <string>
 #include "util.h"
@@ -26,6 +27,21 @@ enum class NodeType {
 #undef X
 };
 
+constexpr std::size_t kNumNodeTypes = 0
+#define X(v)       + 1
+    X_NODE_NAMES
+#undef X
+    ;
+
+enum class NodeCategory {
+  OCSILLATOR,
+  SEQUENCER,
+  IO,
+  UTILITY,
+  ARITHMETIC,
+  DEBUG
+};
+
 struct NodeNames {
   NodeNames() {
     #define X(v) type_to_name[NodeType::v] = #v; \
@@ -36,6 +52,10 @@ struct NodeNames {
     #undef X
   }
   
+  bool HasType(const std::string& s) const {
+    return name_to_type.contains(s);
+  }
+
   NodeType GetType(const std::string& s) const {
     return MapGetConstRef(name_to_type, s);
   }
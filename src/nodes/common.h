@@ -1,37 +1,48 @@
 #pragma once
 
+#include <algorithm>
 #include <cmath>
 #include <array>
 #include <deque>
 #include "node.h"
 #include "node_types.h"
+#include "simd/kernels.h"
 
 #include "imgui.h"
 
 
-struct SliderNode : public Node {
+struct SliderNode final : public Node {
   static inline const std::string DISPLAY_NAME = "Slider";
-  static inline const NodeType TYPE = NodeType::SLIDER;
+  static constexpr NodeType TYPE = NodeType::SLIDER;
+  static constexpr NodeCategory CATEGORY = NodeCategory::UTILITY;
 
   SliderNode() {
     type = TYPE;
     display_name = DISPLAY_NAME;
 
-    auto signal_out = std::make_shared<Output>("signal", PinDataType::kFloat, this, 0.0f);
+    Output signal_out("signal", PinDataType::kFloat, this, 0.0f);
+    signal_out.rate = PinRate::kControl;
     outputs = {signal_out};
+    params = {&signal};
     slider_label = GenLabel("slider", this);
     input_label = GenLabel("input", this);
   }
 
   ~SliderNode() {}
 
-  void Process(float time) override {
-    outputs[0]->SetValue<float>(signal);
+  bool IsPure() const override {
+    return true;
+  }
+
+  void ProcessBlock(const BlockInfo& info, const BlockIO& io) override {
+    std::fill_n(io.Out<float>(0), info.size, signal.dsp);
   }
   
   void Draw() override {
     ImGui::PushItemWidth(100.0f);
-    ImGui::SliderFloat(slider_label.c_str(), &signal, v_min_max[0], v_min_max[1], "%.2f", ImGuiSliderFlags_None);
+    if (ImGui::SliderFloat(slider_label.c_str(), &signal.ui, v_min_max[0], v_min_max[1], "%.2f", ImGuiSliderFlags_None)) {
+      signal.Touch();
+    }
     ImGui::InputFloat2(input_label.c_str(), v_min_max.data(), "%.2f", ImGuiInputTextFlags_None);
     ImGui::PopItemWidth();
   }
@@ -39,17 +50,17 @@ struct SliderNode : public Node {
   void Save(nlohmann::json& j) const override {
     JsonSetValue(j, "v_min", v_min_max[0]);
     JsonSetValue(j, "v_max", v_min_max[1]);
-    JsonSetValue(j, "signal", signal);
+    JsonSetValue(j, "signal", signal.ui);
   }
 
   void Load(const nlohmann::json& j) override {
     JsonGetValue(j, "v_min", v_min_max[0]);
     JsonGetValue(j, "v_max", v_min_max[1]);
-    JsonGetValue(j, "signal", signal);
+    signal.Reset(JsonGetValue<float>(j, "signal"));
   }
 
  protected:
-  float signal;
+  Param<float> signal;
   std::array<float, 2> v_min_max;
   
   // These labels are a hack to have a unique id for all input fields. 
@@ -58,109 +69,135 @@ struct SliderNode : public Node {
   std::string input_label;
 };
 
-struct ConstantNode : public Node {
+struct ConstantNode final : public Node {
   static inline const std::string DISPLAY_NAME = "Constant";
-  static inline const NodeType TYPE = NodeType::CONSTANT;
+  static constexpr NodeType TYPE = NodeType::CONSTANT;
+  static constexpr NodeCategory CATEGORY = NodeCategory::UTILITY;
 
   ConstantNode() { 
     type = TYPE;
     display_name = DISPLAY_NAME;
 
-    auto signal_out = std::make_shared<Output>("signal", PinDataType::kFloat, this, 0.0f);
+    Output signal_out("signal", PinDataType::kFloat, this, 0.0f);
+    signal_out.rate = PinRate::kControl;
     outputs = {signal_out};
+    params = {&signal};
     input_label = GenLabel("input", this);
   }
 
   ~ConstantNode() {}
 
-  void Process(float time) override {
-    outputs[0]->SetValue<float>(signal);
+  bool IsPure() const override {
+    return true;
+  }
+
+  void ProcessBlock(const BlockInfo& info, const BlockIO& io) override {
+    std::fill_n(io.Out<float>(0), info.size, signal.dsp);
   }
   
   void Draw() override {
     ImGui::PushItemWidth(100.0f);
-    ImGui::InputFloat(input_label.c_str(), &signal, 0.0f, 0.0f, "%.2f", ImGuiInputTextFlags_None);
+    if (ImGui::InputFloat(input_label.c_str(), &signal.ui, 0.0f, 0.0f, "%.2f", ImGuiInputTextFlags_None)) {
+      signal.Touch();
+    }
     ImGui::PopItemWidth();
   }
 
   void Save(nlohmann::json& j) const override {
-    JsonSetValue(j, "signal", signal);
+    JsonSetValue(j, "signal", signal.ui);
   }
 
   void Load(const nlohmann::json& j) override {
-    JsonGetValue(j, "signal", signal);
+    signal.Reset(JsonGetValue<float>(j, "signal"));
   }
 
  protected:
-  float signal;
+  Param<float> signal;
   std::string input_label;
 };
 
-struct MixNode : public Node {
+struct MixNode final : public Node {
   static inline const std::string DISPLAY_NAME = "Mix";
-  static inline const NodeType TYPE = NodeType::MIX;
+  static constexpr NodeType TYPE = NodeType::MIX;
+  static constexpr NodeCategory CATEGORY = NodeCategory::ARITHMETIC;
 
   MixNode() { 
     type = TYPE;
     display_name = DISPLAY_NAME;
 
-    auto input_a = std::make_shared<Input>("input_a", PinDataType::kFloat, this, 0.0f);
-    auto input_b = std::make_shared<Input>("input_b", PinDataType::kFloat, this, 0.0f);
-    auto alpha = std::make_shared<Input>("alpha", PinDataType::kFloat, this, 0.0f);
-    auto signal = std::make_shared<Output>("signal", PinDataType::kFloat, this, 0.0f);
+    Input input_a("input_a", PinDataType::kFloat, this, 0.0f);
+    Input input_b("input_b", PinDataType::kFloat, this, 0.0f);
+    Input alpha("alpha", PinDataType::kFloat, this, 0.0f);
+    Output signal("signal", PinDataType::kFloat, this, 0.0f);
 
     inputs = {input_a, input_b, alpha};
     outputs = {signal};
+    params = {&alpha_param};
 
     slider_label = GenLabel("slider", this);
   }
 
   ~MixNode() {}
 
-  void Process(float time) override {
-    float alpha = inputs[2]->GetValue<float>();
-    if (!inputs[2]->IsConnected()) {
-      alpha = alpha_param;
+  bool IsPure() const override {
+    return true;
+  }
+
+  void ProcessBlock(const BlockInfo& info, const BlockIO& io) override {
+    const float* a = io.In<float>(0);
+    const float* b = io.In<float>(1);
+    float* res = io.Out<float>(0);
+
+    if (io.IsConnected(2)) {
+      GetBlockKernels().mix(a, b, io.In<float>(2), res, info.size);
+    } else {
+      GetBlockKernels().mix_scalar(a, b, alpha_param.dsp, res, info.size);
     }
+  }
 
-    float res = inputs[0]->GetValue<float>() * (1.0f - alpha) + 
-                inputs[1]->GetValue<float>() * alpha;
-    outputs[0]->SetValue<float>(res);
+  std::optional<ElementwiseOp> GetElementwiseOp(const BlockIO& io) const override {
+    if (io.IsConnected(2)) {
+      return ElementwiseOp{ElementwiseOp::kMix};
+    }
+    return ElementwiseOp{ElementwiseOp::kMixScalar, &alpha_param.dsp};
   }
   
   void Draw() override {
     ImGui::PushItemWidth(100.0f);
-    ImGui::SliderFloat(slider_label.c_str(), &alpha_param, 0.0f, 1.0f, "%.2f", ImGuiSliderFlags_None);
+    if (ImGui::SliderFloat(slider_label.c_str(), &alpha_param.ui, 0.0f, 1.0f, "%.2f", ImGuiSliderFlags_None)) {
+      alpha_param.Touch();
+    }
     ImGui::PopItemWidth();
   }
 
   void Save(nlohmann::json& j) const override {
-    JsonSetValue(j, "alpha", alpha_param);
+    JsonSetValue(j, "alpha", alpha_param.ui);
   }
 
   void Load(const nlohmann::json& j) override {
-    JsonGetValue(j, "alpha", alpha_param);
+    alpha_param.Reset(JsonGetValue<float>(j, "alpha"));
   }
 
  protected:
-  float alpha_param;
+  Param<float> alpha_param;
   float signal;
 
   std::string slider_label;
 };
 
-struct AddNode : public Node {
+struct AddNode final : public Node {
   static inline const std::string DISPLAY_NAME = "Add";
-  static inline const NodeType TYPE = NodeType::ADD;
+  static constexpr NodeType TYPE = NodeType::ADD;
+  static constexpr NodeCategory CATEGORY = NodeCategory::ARITHMETIC;
 
   AddNode() { 
     type = TYPE;
     display_name = DISPLAY_NAME;
 
-    auto input_a = std::make_shared<Input>("a", PinDataType::kFloat, this, 0.0f);
-    auto input_b = std::make_shared<Input>("b", PinDataType::kFloat, this, 0.0f);
-    auto input_c = std::make_shared<Input>("c", PinDataType::kFloat, this, 0.0f);
-    auto signal  = std::make_shared<Output>("signal", PinDataType::kFloat, this, 0.0f);
+    Input input_a("a", PinDataType::kFloat, this, 0.0f);
+    Input input_b("b", PinDataType::kFloat, this, 0.0f);
+    Input input_c("c", PinDataType::kFloat, this, 0.0f);
+    Output signal("signal", PinDataType::kFloat, this, 0.0f);
 
     inputs = {input_a, input_b, input_c};
     outputs = {signal};
@@ -168,25 +205,31 @@ struct AddNode : public Node {
 
   ~AddNode() {}
 
-  void Process(float time) override {
-    float res = inputs[0]->GetValue<float>() + 
-                inputs[1]->GetValue<float>() +
-                inputs[2]->GetValue<float>();
-    outputs[0]->SetValue<float>(res);
+  bool IsPure() const override {
+    return true;
+  }
+
+  void ProcessBlock(const BlockInfo& info, const BlockIO& io) override {
+    GetBlockKernels().add3(io.In<float>(0), io.In<float>(1), io.In<float>(2), io.Out<float>(0), info.size);
+  }
+
+  std::optional<ElementwiseOp> GetElementwiseOp(const BlockIO& io) const override {
+    return ElementwiseOp{ElementwiseOp::kAdd3};
   }
 };
 
-struct MultiplyNode : public Node {
+struct MultiplyNode final : public Node {
   static inline const std::string DISPLAY_NAME = "Multiply";
-  static inline const NodeType TYPE = NodeType::MULTIPLY;
+  static constexpr NodeType TYPE = NodeType::MULTIPLY;
+  static constexpr NodeCategory CATEGORY = NodeCategory::ARITHMETIC;
 
   MultiplyNode() { 
     type = TYPE;
     display_name = DISPLAY_NAME;
 
-    auto input_a = std::make_shared<Input>("a", PinDataType::kFloat, this, 1.0f);
-    auto input_b = std::make_shared<Input>("b", PinDataType::kFloat, this, 1.0f);
-    auto signal  = std::make_shared<Output>("signal", PinDataType::kFloat, this, 0.0f);
+    Input input_a("a", PinDataType::kFloat, this, 1.0f);
+    Input input_b("b", PinDataType::kFloat, this, 1.0f);
+    Output signal("signal", PinDataType::kFloat, this, 0.0f);
 
     inputs = {input_a, input_b};
     outputs = {signal};
@@ -194,72 +237,92 @@ struct MultiplyNode : public Node {
 
   ~MultiplyNode() {}
 
-  void Process(float time) override {
-    float res = inputs[0]->GetValue<float>() * 
-                inputs[1]->GetValue<float>(); 
-    outputs[0]->SetValue<float>(res);
+  bool IsPure() const override {
+    return true;
+  }
+
+  void ProcessBlock(const BlockInfo& info, const BlockIO& io) override {
+    GetBlockKernels().multiply(io.In<float>(0), io.In<float>(1), io.Out<float>(0), info.size);
+  }
+
+  std::optional<ElementwiseOp> GetElementwiseOp(const BlockIO& io) const override {
+    return ElementwiseOp{ElementwiseOp::kMultiply};
   }
 };
 
-struct ClampNode : public Node {
+struct ClampNode final : public Node {
   static inline const std::string DISPLAY_NAME = "Clamp";
-  static inline const NodeType TYPE = NodeType::CLAMP;
+  static constexpr NodeType TYPE = NodeType::CLAMP;
+  static constexpr NodeCategory CATEGORY = NodeCategory::ARITHMETIC;
 
   ClampNode() { 
     type = TYPE;
     display_name = DISPLAY_NAME;
 
     inputs = {
-      std::make_shared<Input>("x", PinDataType::kFloat, this, 1.0f),
-      std::make_shared<Input>("v_min", PinDataType::kFloat, this, 1.0f),
-      std::make_shared<Input>("v_max", PinDataType::kFloat, this, 1.0f)
+      Input("x", PinDataType::kFloat, this, 1.0f),
+      Input("v_min", PinDataType::kFloat, this, 1.0f),
+      Input("v_max", PinDataType::kFloat, this, 1.0f)
     };
-    outputs = {std::make_shared<Output>("signal", PinDataType::kFloat, this, 0.0f)};
+    outputs = {Output("signal", PinDataType::kFloat, this, 0.0f)};
   }
 
   ~ClampNode() {}
 
-  void Process(float time) override {
-    float x = inputs[0]->GetValue<float>();
-    float v_min = inputs[1]->GetValue<float>();
-    float v_max = inputs[2]->GetValue<float>();
+  bool IsPure() const override {
+    return true;
+  }
 
-    float res = std::clamp(x, v_min, v_max);
-    outputs[0]->SetValue<float>(res);
+  void ProcessBlock(const BlockInfo& info, const BlockIO& io) override {
+    GetBlockKernels().clamp(io.In<float>(0), io.In<float>(1), io.In<float>(2), io.Out<float>(0), info.size);
+  }
+
+  std::optional<ElementwiseOp> GetElementwiseOp(const BlockIO& io) const override {
+    return ElementwiseOp{ElementwiseOp::kClamp};
   }
 };
 
-struct NegateNode : public Node {
+struct NegateNode final : public Node {
   static inline const std::string DISPLAY_NAME = "Negate";
-  static inline const NodeType TYPE = NodeType::NEGATE;
+  static constexpr NodeType TYPE = NodeType::NEGATE;
+  static constexpr NodeCategory CATEGORY = NodeCategory::ARITHMETIC;
 
   NegateNode() { 
     type = TYPE;
     display_name = DISPLAY_NAME;
 
-    inputs = {std::make_shared<Input>("x", PinDataType::kFloat, this, 0.0f)};
-    outputs = {std::make_shared<Output>("y", PinDataType::kFloat, this, 0.0f)};
+    inputs = {Input("x", PinDataType::kFloat, this, 0.0f)};
+    outputs = {Output("y", PinDataType::kFloat, this, 0.0f)};
   }
 
   ~NegateNode() {}
 
-  void Process(float time) override {
-    float x = inputs[0]->GetValue<float>();
-    outputs[0]->SetValue<float>(-x);
+  bool IsPure() const override {
+    return true;
+  }
+
+  void ProcessBlock(const BlockInfo& info, const BlockIO& io) override {
+    GetBlockKernels().negate(io.In<float>(0), io.Out<float>(0), info.size);
+  }
+
+  std::optional<ElementwiseOp> GetElementwiseOp(const BlockIO& io) const override {
+    return ElementwiseOp{ElementwiseOp::kNegate};
   }
 };
 
 const int NUM_DEBUG_VALUES = 100;
 
-struct DebugNode : public Node {
+struct DebugNode final : public Node {
   static inline const std::string DISPLAY_NAME = "Debug";
-  static inline const NodeType TYPE = NodeType::DEBUG;
+  static constexpr NodeType TYPE = NodeType::DEBUG;
+  static constexpr NodeCategory CATEGORY = NodeCategory::DEBUG;
 
   DebugNode() : values(NUM_DEBUG_VALUES) { 
     type = TYPE;
     display_name = DISPLAY_NAME;
 
-    inputs = {std::make_shared<Input>("x", PinDataType::kFloat, this, 0.0f)};
+    inputs = {Input("x", PinDataType::kFloat, this, 0.0f)};
+    params = {&resolution};
     
     plot_label = GenLabel("plot", this);
     min_max_label = GenLabel("mm", this);
@@ -268,19 +331,26 @@ struct DebugNode : public Node {
 
   ~DebugNode() {}
 
-  void Process(float time) override {
-    if (time < prev_time) {
-      prev_time = time;
-    }
+  bool IsSink() const override {
+    return true;
+  }
 
-    if (time - prev_time < resolution / 1000.0f) {
-      return;
-    }
+  void ProcessBlock(const BlockInfo& info, const BlockIO& io) override {
+    const float* x = io.In<float>(0);
+    for (size_t i = 0; i < info.size; ++i) {
+      float time = info.TimeAt(i);
+      if (time < prev_time) {
+        prev_time = time;
+      }
 
-    prev_time = time;
-    float val = inputs[0]->GetValue<float>();
-    values[cur_idx % NUM_DEBUG_VALUES] = val;
-    ++cur_idx;
+      if (time - prev_time < resolution.dsp / 1000.0f) {
+        continue;
+      }
+
+      prev_time = time;
+      values[cur_idx % NUM_DEBUG_VALUES] = x[i];
+      ++cur_idx;
+    }
   }
   
   void Draw() override {
@@ -288,25 +358,27 @@ struct DebugNode : public Node {
     ImGui::PushItemWidth(200.0f);
     ImGui::PlotLines(plot_label.c_str(), data.data(), data.size(), cur_idx, NULL, v_min_max[0], v_min_max[1], ImVec2(0, 80));
     ImGui::InputFloat2(min_max_label.c_str(), v_min_max.data(), "%.2f", ImGuiInputTextFlags_None);
-    ImGui::SliderFloat(slider_label.c_str(), &resolution, 0.0f, 1000.0f, "%.2f", ImGuiSliderFlags_None);
+    if (ImGui::SliderFloat(slider_label.c_str(), &resolution.ui, 0.0f, 1000.0f, "%.2f", ImGuiSliderFlags_None)) {
+      resolution.Touch();
+    }
     ImGui::PopItemWidth();
   }
 
   void Save(nlohmann::json& j) const override {
     JsonSetValue(j, "v_min_max", v_min_max);
-    JsonSetValue(j, "resolution", resolution);
+    JsonSetValue(j, "resolution", resolution.ui);
   }
 
   void Load(const nlohmann::json& j) override {
     JsonGetValue(j, "v_min_max", v_min_max);
-    JsonGetValue(j, "resolution", resolution);
+    resolution.Reset(JsonGetValue<float>(j, "resolution"));
   }
   
  private:
   int cur_idx = 0;
   std::vector<float> values;
   std::array<float, 2> v_min_max;
-  float resolution = 1.0f;
+  Param<float> resolution = 1.0f;
   
   float prev_time = 0.0f;
   
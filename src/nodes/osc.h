@@ -1,87 +1,121 @@
 #pragma once
 
 #include <cmath>
+#include <cstdint>
 #include "node.h"
 #include "node_types.h"
+#include "simd/kernels.h"
 
 #include "imgui.h"
 
 class OscillatorNode : public Node {
  public:
   OscillatorNode() {
-    auto freq = std::make_shared<Input>("freq", PinDataType::kFloat, this, 440.0f);
-    auto amp = std::make_shared<Input>("amp", PinDataType::kFloat, this, 0.5f);
-    auto phase = std::make_shared<Input>("phase", PinDataType::kFloat, this, 0.0f);
-    auto signal = std::make_shared<Output>("signal", PinDataType::kFloat, this, 0.0f);
+    Input freq("freq", PinDataType::kFloat, this, 440.0f);
+    Input amp("amp", PinDataType::kFloat, this, 0.5f);
+    Input phase("phase", PinDataType::kFloat, this, 0.0f);
+    Output signal("signal", PinDataType::kFloat, this, 0.0f);
 
     inputs = {freq, amp, phase};
     outputs = {signal};
   }
+
+ protected:
+  // Phase is a 32 bit fixed point fraction of a turn. It wraps for free,
+  // and advancing it by a whole number of samples is exact, so the pitch
+  // is the same after a second or after a day of playback.
+  static std::uint32_t PhaseIncrement(float freq, float dt) {
+    // Through int64 so that negative frequencies wrap around too.
+    return static_cast<std::uint32_t>(std::llround(static_cast<double>(freq) * dt * 0x1p32));
+  }
+
+  // Top 24 bits fit a float mantissa exactly. Result is in [0, 1).
+  static float PhaseToTurns(std::uint32_t phase) {
+    return static_cast<float>(phase >> 8) * 0x1p-24f;
+  }
+
+  std::uint32_t phase_acc = 0;
 };
 
-struct SineOscillatorNode : public OscillatorNode {
+struct SineOscillatorNode final : public OscillatorNode {
   static inline const std::string DISPLAY_NAME = "Sine wave";
-  static inline const NodeType TYPE = NodeType::SINE_OSC;
+  static constexpr NodeType TYPE = NodeType::SINE_OSC;
+  static constexpr NodeCategory CATEGORY = NodeCategory::OCSILLATOR;
 
   SineOscillatorNode() : OscillatorNode() { 
     type = TYPE;
     display_name = DISPLAY_NAME;
     
+    params = {&freq_param, &amp_param};
     freq_label = GenLabel("1", this, "freq");
     amp_label = GenLabel("2", this, "amp");
   }
 
   ~SineOscillatorNode() {}
 
-  void Process(float time) override {
-    if (inputs[0]->IsConnected()) {
-      freq = inputs[0]->GetValue<float>();
+  void ProcessBlock(const BlockInfo& info, const BlockIO& io) override {
+    const float* freq_in = io.In<float>(0);
+    const float* phase = io.In<float>(2);
+    float* wave = io.Out<float>(0);
+    bool freq_connected = io.IsConnected(0);
+
+    const float inv_two_pi = static_cast<float>(0.5 / M_PI);
+    alignas(64) float turns[kMaxBlockSize];
+    if (freq_connected) {
+      for (size_t i = 0; i < info.size; ++i) {
+        turns[i] = PhaseToTurns(phase_acc) + phase[i] * inv_two_pi;
+        phase_acc += PhaseIncrement(freq_in[i], info.dt);
+      }
     } else {
-      freq = freq_param;
+      std::uint32_t increment = PhaseIncrement(freq_param.dsp, info.dt);
+      for (size_t i = 0; i < info.size; ++i) {
+        turns[i] = PhaseToTurns(phase_acc) + phase[i] * inv_two_pi;
+        phase_acc += increment;
+      }
     }
 
-    if (inputs[1]->IsConnected()) {
-      amp = inputs[1]->GetValue<float>();
+    auto& kernels = GetBlockKernels();
+    kernels.sine(turns, wave, info.size);
+    if (io.IsConnected(1)) {
+      kernels.multiply(wave, io.In<float>(1), wave, info.size);
     } else {
-      amp = amp_param;
+      kernels.scale(wave, amp_param.dsp, wave, info.size);
     }
-    
-    float phase = inputs[2]->GetValue<float>();
-    float wave = amp * sin(time * 2.0 * M_PI * freq + phase);
-    outputs[0]->SetValue<float>(wave);
   }
   
   void Draw() override {
     ImGui::PushItemWidth(100.0f);
-    ImGui::SliderFloat(freq_label.c_str(), &freq_param, 0.0f, 1000.0f, "%.2f", ImGuiSliderFlags_None);
-    ImGui::SliderFloat(amp_label.c_str(), &amp_param, 0.0f, 1.0f, "%.2f", ImGuiSliderFlags_None);
+    if (ImGui::SliderFloat(freq_label.c_str(), &freq_param.ui, 0.0f, 1000.0f, "%.2f", ImGuiSliderFlags_None)) {
+      freq_param.Touch();
+    }
+    if (ImGui::SliderFloat(amp_label.c_str(), &amp_param.ui, 0.0f, 1.0f, "%.2f", ImGuiSliderFlags_None)) {
+      amp_param.Touch();
+    }
     ImGui::PopItemWidth();
   }
   
   void Save(nlohmann::json& j) const override {
-    JsonSetValue(j, "freq", freq_param);
-    JsonSetValue(j, "amp", amp_param);
+    JsonSetValue(j, "freq", freq_param.ui);
+    JsonSetValue(j, "amp", amp_param.ui);
   }
 
   void Load(const nlohmann::json& j) override {
-    JsonGetValue<float>(j, "freq", freq_param);
-    JsonGetValue<float>(j, "amp", amp_param);
+    freq_param.Reset(JsonGetValue<float>(j, "freq"));
+    amp_param.Reset(JsonGetValue<float>(j, "amp"));
   }
 
  private:
-  float freq;
-  float amp;
-  
-  float freq_param = 440.0f;
-  float amp_param = 0.5f;
+  Param<float> freq_param = 440.0f;
+  Param<float> amp_param = 0.5f;
   
   std::string freq_label;
   std::string amp_label;
 };
 
-struct SquareOscillatorNode : public OscillatorNode {
+struct SquareOscillatorNode final : public OscillatorNode {
   static inline const std::string DISPLAY_NAME = "Square wave";
-  static inline const NodeType TYPE = NodeType::SQUARE_OSC;
+  static constexpr NodeType TYPE = NodeType::SQUARE_OSC;
+  static constexpr NodeCategory CATEGORY = NodeCategory::OCSILLATOR;
 
   SquareOscillatorNode() : OscillatorNode() { 
     type = TYPE;
@@ -90,18 +124,32 @@ struct SquareOscillatorNode : public OscillatorNode {
 
   ~SquareOscillatorNode() {}
 
-  void Process(float time) override {
-    if (inputs[0]->IsConnected()) {
-      freq = inputs[0]->GetValue<float>();
-    }
-
-    if (inputs[1]->IsConnected()) {
-      amp = inputs[1]->GetValue<float>();
+  void ProcessBlock(const BlockInfo& info, const BlockIO& io) override {
+    const float* freq_in = io.In<float>(0);
+    const float* amp_in = io.In<float>(1);
+    float* wave = io.Out<float>(0);
+    bool freq_connected = io.IsConnected(0);
+    bool amp_connected = io.IsConnected(1);
+
+    alignas(64) float turns[kMaxBlockSize];
+    alignas(64) float amps[kMaxBlockSize];
+    for (size_t i = 0; i < info.size; ++i) {
+      if (freq_connected) {
+        freq = freq_in[i];
+      }
+
+      if (amp_connected) {
+        amp = amp_in[i];
+      }
+
+      turns[i] = PhaseToTurns(phase_acc);
+      amps[i] = amp;
+      phase_acc += PhaseIncrement(freq, info.dt);
     }
 
-    float t = std::fmod(time,  1.0f / freq) * freq;
-    float wave = amp * (t > 0.5f ? 1.0f : -1.0f);
-    outputs[0]->SetValue<float>(wave);
+    auto& kernels = GetBlockKernels();
+    kernels.square(turns, wave, info.size);
+    kernels.multiply(wave, amps, wave, info.size);
   }
   
  private: 
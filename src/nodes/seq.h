@@ -1,6 +1,8 @@
 #pragma once
 
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include "node.h"
 #include "node_types.h"
 #include "util.h"
@@ -8,18 +10,22 @@
 #include "imgui.h"
 
 // Will enable the note every tick in the measure for a specified amount of time
-struct ClockNode : public Node {
+struct ClockNode final : public Node {
   static inline const std::string DISPLAY_NAME = "Clock";
-  static inline const NodeType TYPE = NodeType::CLOCK;
+  static constexpr NodeType TYPE = NodeType::CLOCK;
+  static constexpr NodeCategory CATEGORY = NodeCategory::SEQUENCER;
 
   ClockNode() : oct(1) {
     type = TYPE;
     display_name = DISPLAY_NAME;
 
+    // Audio rate: gates and note changes land on their exact sample, and
+    // a control-rate channel would reach float inputs through a ramp.
+    Output ch("ch", PinDataType::kChannel, this, Channel{});
     inputs = {};
-    outputs = {
-      std::make_shared<Output>("ch", PinDataType::kChannel, this, Channel{})
-    };
+    outputs = {ch};
+
+    params = {&bpm_param, &measure_param, &note_size};
 
     bpm_slider_label = GenLabel("slider", this);
     bpm_label = GenLabel("bpm", this);
@@ -29,44 +35,66 @@ struct ClockNode : public Node {
 
   ~ClockNode() {}
 
-  void Process(float time) override {
-    Channel& value = outputs[0]->GetValue<Channel>();
-    float quater_beat_length = 60.0f / bpm_param;
-    float measure_beat_length = quater_beat_length * 4.0f / static_cast<float>(measure_param[1]);
-    int beat_id = static_cast<int>(time / measure_beat_length) % measure_param[0];
-
-    value.note = beat_id == 0 ? oct.Get(Tone::C) : oct.Get(Tone::G);
-    value.begin = std::floor(time / measure_beat_length) * measure_beat_length;
-    value.end = value.begin + measure_beat_length * note_size;
-    value.velocity = time > value.end ? 0.0f : 1.0f;
+  // The grid comes from the sample clock, which never wraps, so beats stay
+  // in place however long the session. Only the time within the current
+  // beat is a float; begin and end are timestamps like info.time.
+  void ProcessBlock(const BlockInfo& info, const BlockIO& io) override {
+    Channel* ch = io.Out<Channel>(0);
+    auto measure = measure_param.dsp;
+    double quater_beat_length = 60.0 / bpm_param.dsp;
+    double measure_beat_length = quater_beat_length * 4.0 / measure[1];
+    double beat_samples = measure_beat_length * kSampleRate;
+    float note_length = static_cast<float>(measure_beat_length * note_size.dsp);
+    std::uint64_t beats_per_measure = std::max(measure[0], 1);
+
+    for (size_t i = 0; i < info.size; ++i) {
+      double position = static_cast<double>(info.PositionAt(i));
+      double beat = std::floor(position / beat_samples);
+      auto beat_id = static_cast<std::uint64_t>(beat) % beats_per_measure;
+      float since_begin = static_cast<float>((position - beat * beat_samples) / kSampleRate);
+
+      Channel& value = ch[i];
+      value.note = beat_id == 0 ? oct.Get(Tone::C) : oct.Get(Tone::G);
+      value.begin = info.TimeAt(i) - since_begin;
+      value.end = value.begin + note_length;
+      value.velocity = since_begin > note_length ? 0.0f : 1.0f;
+    }
   }
   
   void Draw() override {
     ImGui::PushItemWidth(100.0f);
-    ImGui::SliderFloat(bpm_slider_label.c_str(), &bpm_param, 0.0f, 1000.0f, "%.2f", ImGuiSliderFlags_None);
-    ImGui::InputFloat(bpm_label.c_str(), &bpm_param, 0.0f, 0.0f, "%.2f", ImGuiInputTextFlags_None);
-    ImGui::InputInt2(measure_label.c_str(), measure_param.data(), ImGuiInputTextFlags_None);
-    ImGui::InputFloat(note_size_label.c_str(), &note_size, 0.0f, 0.0f, "%.2f", ImGuiInputTextFlags_None);
+    if (ImGui::SliderFloat(bpm_slider_label.c_str(), &bpm_param.ui, 0.0f, 1000.0f, "%.2f", ImGuiSliderFlags_None)) {
+      bpm_param.Touch();
+    }
+    if (ImGui::InputFloat(bpm_label.c_str(), &bpm_param.ui, 0.0f, 0.0f, "%.2f", ImGuiInputTextFlags_None)) {
+      bpm_param.Touch();
+    }
+    if (ImGui::InputInt2(measure_label.c_str(), measure_param.ui.data(), ImGuiInputTextFlags_None)) {
+      measure_param.Touch();
+    }
+    if (ImGui::InputFloat(note_size_label.c_str(), &note_size.ui, 0.0f, 0.0f, "%.2f", ImGuiInputTextFlags_None)) {
+      note_size.Touch();
+    }
     ImGui::PopItemWidth();
   }
   
   void Save(nlohmann::json& j) const override {
-    JsonSetValue(j, "bpm", bpm_param);
-    JsonSetValue(j, "measure", measure_param);
-    JsonSetValue(j, "note_size", note_size);
+    JsonSetValue(j, "bpm", bpm_param.ui);
+    JsonSetValue(j, "measure", measure_param.ui);
+    JsonSetValue(j, "note_size", note_size.ui);
   }
 
   void Load(const nlohmann::json& j) override {
-    JsonGetValue(j, "bpm", bpm_param);
-    JsonGetValue(j, "measure", measure_param);
-    JsonGetValue(j, "note_size", note_size);
+    bpm_param.Reset(JsonGetValue<float>(j, "bpm"));
+    measure_param.Reset(JsonGetValue<std::array<int, 2>>(j, "measure"));
+    note_size.Reset(JsonGetValue<float>(j, "note_size"));
   }
 
  protected:
   Octave oct;
-  float bpm_param = 100.0f;  // Quater notes per minute
-  std::array<int, 2> measure_param = {4, 4};  // Ex. 3 / 4
-  float note_size = 0.5f;  // Fraction of the note in relation to measure.
+  Param<float> bpm_param = 100.0f;  // Quater notes per minute
+  Param<std::array<int, 2>> measure_param = std::array<int, 2>{4, 4};  // Ex. 3 / 4
+  Param<float> note_size = 0.5f;  // Fraction of the note in relation to measure.
   
   std::string bpm_slider_label;
   std::string bpm_label;
@@ -74,33 +102,45 @@ struct ClockNode : public Node {
   std::string note_size_label;
 };
 
-struct ChannelUnpackNode : public Node {
+struct ChannelUnpackNode final : public Node {
   static inline const std::string DISPLAY_NAME = "Channel unpack";
-  static inline const NodeType TYPE = NodeType::CHANNEL_UNPACK;
+  static constexpr NodeType TYPE = NodeType::CHANNEL_UNPACK;
+  static constexpr NodeCategory CATEGORY = NodeCategory::UTILITY;
 
   ChannelUnpackNode() {
     type = TYPE;
     display_name = DISPLAY_NAME;
 
     inputs = {
-      std::make_shared<Input>("ch", PinDataType::kChannel, this, Channel{})
+      Input("ch", PinDataType::kChannel, this, Channel{})
     };
 
     outputs = {
-      std::make_shared<Output>("freq",  PinDataType::kFloat, this, 0.0f),
-      std::make_shared<Output>("begin", PinDataType::kFloat, this, 0.0f),
-      std::make_shared<Output>("end",   PinDataType::kFloat, this, 0.0f),
-      std::make_shared<Output>("vel",   PinDataType::kFloat, this, 0.0f)
+      Output("freq",  PinDataType::kFloat, this, 0.0f),
+      Output("begin", PinDataType::kFloat, this, 0.0f),
+      Output("end",   PinDataType::kFloat, this, 0.0f),
+      Output("vel",   PinDataType::kFloat, this, 0.0f)
     };
   }
   
   ~ChannelUnpackNode() {}
 
-  void Process(float time) override {
-    auto in = inputs[0]->GetValue<Channel>();
-    outputs[0]->SetValue<float>(in.note.frequency);
-    outputs[1]->SetValue<float>(in.begin);
-    outputs[2]->SetValue<float>(in.end);
-    outputs[3]->SetValue<float>(in.velocity);
+  bool IsPure() const override {
+    return true;
+  }
+
+  void ProcessBlock(const BlockInfo& info, const BlockIO& io) override {
+    const Channel* in = io.In<Channel>(0);
+    float* freq = io.Out<float>(0);
+    float* begin = io.Out<float>(1);
+    float* end = io.Out<float>(2);
+    float* vel = io.Out<float>(3);
+
+    for (size_t i = 0; i < info.size; ++i) {
+      freq[i] = in[i].note.frequency;
+      begin[i] = in[i].begin;
+      end[i] = in[i].end;
+      vel[i] = in[i].velocity;
+    }
   }
 };
@@ -1,26 +1,41 @@
 #pragma once
 
 #include "node.h"
-#include "audio_thread.h"
+#include "output.h"
 
 
-struct AudioOutputNode : public Node {
+struct AudioOutputNode final : public Node {
   static inline const std::string DISPLAY_NAME = "Audio Output";
-  static inline const NodeType TYPE = NodeType::OUTPUT;
+  static constexpr NodeType TYPE = NodeType::OUTPUT;
+  static constexpr NodeCategory CATEGORY = NodeCategory::IO;
 
   AudioOutputNode(std::shared_ptr<AudioOutput> output) : output(output) { 
     type = TYPE;
     display_name = DISPLAY_NAME;
 
-    auto signal = std::make_shared<Input>("signal", PinDataType::kFloat, this, 0.0f);
-    inputs = {signal};
+    // One input per channel, the first one used to be the mono "signal".
+    inputs.reserve(kNumChannels);
+    for (int ch = 0; ch < kNumChannels; ++ch) {
+      inputs.emplace_back(ChannelName(ch), PinDataType::kFloat, this, 0.0f);
+    }
   }
 
   ~AudioOutputNode() {}
 
-  void Process(float time) override {
-    float wave = inputs[0]->GetValue<float>();
-    output->wave = wave;
+  bool IsSink() const override {
+    return true;
+  }
+
+  // Unconnected channels play the first one, so mono patches reach
+  // every speaker.
+  void ProcessBlock(const BlockInfo& info, const BlockIO& io) override {
+    for (int ch = 0; ch < kNumChannels; ++ch) {
+      const float* wave = io.In<float>(io.IsConnected(ch) ? ch : 0);
+      std::copy_n(wave, info.size, output->block[ch].begin());
+    }
+    if (info.size > 0) {
+      output->wave = io.In<float>(0)[info.size - 1];
+    }
   }
   
   void Draw() override {
@@ -31,5 +46,12 @@ struct AudioOutputNode : public Node {
   }
 
  private:
+  static std::string ChannelName(int ch) {
+    if (kNumChannels == 2) {
+      return ch == 0 ? "left" : "right";
+    }
+    return "channel " + std::to_string(ch + 1);
+  }
+
   std::shared_ptr<AudioOutput> output;
 };
\ No newline at end of file
@@ -1,86 +1,135 @@
 #pragma once
 
 #include <cstdio>
-#include <cassert>
 #include <cmath>
 #include <iostream>
 #include <algorithm>
+#include <array>
 #include <memory>
+#include <random>
 #include <vector>
 
-#include <pulse/pulseaudio.h>
-
+#include "check.h"
 #include "ring_buffer.h"
-
-#include "rtaudio/RtAudio.h"
+#include "simd/kernels.h"
 
 // Audio constants are all hardcoded here for now.
 const int kSampleRate = 44100;
-const pa_sample_format kSampleFormat = PA_SAMPLE_S16LE;
 const int kNumChannels = 2;
+const std::size_t kMaxBlockSize = 128;  // Samples processed by the graph at once.
 
 using SampleType = std::int16_t;  // 16 bit.
-using SampleBuffer = RingBuffer<SampleType>;
+using SampleBuffer = RingBuffer<float>;  // Interleaved frames, converted by the backend
 
+// What the device is fed.
+enum class SampleFormat {
+  kInt16,
+  kFloat32  // Rendered floats as they are, no conversion
+};
+
+// One block per channel, written by the audio output nodes.
 struct AudioOutput {
-  float wave;
+  float wave;  // Last sample of the first channel, for display.
+  std::array<std::array<float, kMaxBlockSize>, kNumChannels> block{};
 };
 
-inline SampleType WaveToSample(float waveform) {
-  waveform = std::clamp(waveform, -1.0f, 1.0f);
-  if (waveform > 0) {
-    return waveform * std::numeric_limits<SampleType>::max();
+// Frames of n samples per channel into out, interleaved.
+inline void InterleaveBlock(const AudioOutput& output, std::size_t n, float* out) {
+  if constexpr (kNumChannels == 2) {
+    GetBlockKernels().interleave2(output.block[0].data(), output.block[1].data(), out, n);
   } else {
-    return -waveform * std::numeric_limits<SampleType>::min();
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t ch = 0; ch < kNumChannels; ++ch) {
+        out[i * kNumChannels + ch] = output.block[ch][i];
+      }
+    }
   }
 }
 
-class RtAudioOutputHandler {
+// Float to 16 bit, a block at a time. With dither, triangular noise of
+// +-1 LSB is added before rounding, which turns quantization distortion of
+// quiet signals into a constant noise floor. The noise comes from a table
+// read at a random offset per call, so conversion stays a single pass.
+class Int16Converter {
  public:
-  RtAudioOutputHandler(int buf_size);
-  ~RtAudioOutputHandler();
-  void Start();
-  void Stop();
-  bool IsPlaying() const;
-  auto GetBuffer() { return buf; }
+  explicit Int16Converter(bool dither = false) : dither(dither) {
+    if (!dither) {
+      return;
+    }
+
+    std::minstd_rand rng;
+    std::uniform_real_distribution<float> uniform(-0.5f, 0.5f);
+    noise.resize(2 * kNoiseSize);
+    for (size_t i = 0; i < kNoiseSize; ++i) {
+      noise[i] = noise[i + kNoiseSize] = uniform(rng) + uniform(rng);
+    }
+  }
+
+  void Convert(const float* in, SampleType* out, std::size_t n) {
+    auto& kernels = GetBlockKernels();
+    if (!dither) {
+      kernels.to_int16(in, nullptr, out, n);
+      return;
+    }
+
+    for (size_t offset = 0; offset < n;) {
+      size_t count = std::min(n - offset, kNoiseSize);
+      const float* window = noise.data() + rng() % kNoiseSize;
+      kernels.to_int16(in + offset, window, out + offset, count);
+      offset += count;
+    }
+  }
+
+  bool IsDithered() const {
+    return dither;
+  }
 
  private:
-  RtAudio dac;
-  std::shared_ptr<SampleBuffer> buf;
+  static const std::size_t kNoiseSize = 4096;
+
+  bool dither;
+  std::vector<float> noise;  // Repeated twice so any window of kNoiseSize is contiguous
+  std::minstd_rand rng;
 };
 
-// Helper for writing to intermediate buffer and ring buffer
+// Seconds at a sample position, wrapped every 6 minutes to keep float
+// precision. Use the position itself for anything that has to stay exact.
+inline float SampleTimestamp(std::uint64_t position) {
+  return (position % (360 * kSampleRate)) / static_cast<float>(kSampleRate);
+}
+
+// Hands out ring buffer space for the renderer to write into directly.
+// The reader sees the samples after Commit().
 class SampleWriter {
  public:
   SampleWriter(std::shared_ptr<SampleBuffer> buffer) 
-    : buffer_(std::move(buffer))
-    , samples_(buffer_->Size()) {
+    : buffer_(std::move(buffer)) {
   }
   
-  // ! Best way to get most accurate time  !
   float GetTimestamp() const {
-    size_t position = buffer_->Position() % (360 * kSampleRate);
-    return (position + sample_idx_) / static_cast<float>(kSampleRate);
+    return SampleTimestamp(GetPosition());
   }
   
+  // Sample clock: position of the next frame to be written. Writer thread only.
+  std::uint64_t GetPosition() const {
+    return buffer_->Position() / kNumChannels;
+  }
+  
+  // In samples, kNumChannels per frame.
   std::size_t ReadyToWrite() {
     return buffer_->ReadyToWrite();
   }
-  
-  void Write(float wave) {
-    ASSERT(sample_idx_ < samples_.size());
-    auto sample = WaveToSample(wave);
-    samples_[sample_idx_] = sample;
-    ++sample_idx_;
+
+  // Space for at most n samples, n <= ReadyToWrite(). Shorter when the
+  // storage wraps: Commit() it, then Reserve() the rest.
+  std::span<float> Reserve(std::size_t n) {
+    return buffer_->Reserve(n);
   }
 
-  void Flush() {
-    buffer_->Write(samples_, sample_idx_);
-    sample_idx_ = 0;
+  void Commit(std::size_t n) {
+    buffer_->Commit(n);
   }
 
  public:
   std::shared_ptr<SampleBuffer> buffer_;
-  std::vector<SampleType> samples_;
-  size_t sample_idx_ = 0;
-};
\ No newline at end of file
+};
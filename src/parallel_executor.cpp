@@ -0,0 +1,169 @@
+#include "parallel_executor.h"
+
+#include <algorithm>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace {
+
+std::uint64_t PackRange(std::uint64_t begin, std::uint64_t end) {
+  return begin | (end << 32);
+}
+
+std::uint64_t RangeBegin(std::uint64_t packed) {
+  return packed & 0xffffffffu;
+}
+
+std::uint64_t RangeEnd(std::uint64_t packed) {
+  return packed >> 32;
+}
+
+void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#else
+  std::this_thread::yield();
+#endif
+}
+
+// Best effort, both fail without the right privileges.
+void SetupWorkerThread(std::thread& thread, std::size_t cpu) {
+  unsigned int num_cpus = std::max(1u, std::thread::hardware_concurrency());
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu % num_cpus, &cpus);
+  pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+
+  sched_param param{};
+  param.sched_priority = sched_get_priority_max(SCHED_FIFO) - 1;
+  if (pthread_setschedparam(thread.native_handle(), SCHED_FIFO, &param) != 0) {
+    std::cout << "Worker " << cpu << " runs without real-time priority" << std::endl;
+  }
+}
+
+}  // namespace
+
+ParallelExecutor::ParallelExecutor(std::size_t num_threads) {
+  // Spinning real-time workers must never share a core.
+  num_threads = std::clamp<std::size_t>(num_threads, 1, std::max(1u, std::thread::hardware_concurrency()));
+  ranges = std::make_unique<Range[]>(num_threads);
+  for (size_t i = 1; i < num_threads; ++i) {
+    workers.emplace_back(&ParallelExecutor::WorkerLoop, this, i);
+    SetupWorkerThread(workers.back(), i);
+  }
+}
+
+ParallelExecutor::~ParallelExecutor() {
+  stopping.store(true);
+  generation.fetch_add(1, std::memory_order_release);
+  generation.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+void ParallelExecutor::Execute(ExecutionPlan& plan_ref, const BlockInfo& block_info) {
+  if (workers.empty() ||
+      plan_ref.NumKernels() < kMinParallelKernels ||
+      plan_ref.MaxLevelWidth() < 2) {
+    plan_ref.Execute(block_info);
+    return;
+  }
+
+  // Workers are parked, nobody touches the shared state.
+  plan = &plan_ref;
+  info = block_info;
+  completed.store(0, std::memory_order_relaxed);
+  opened.store(0, std::memory_order_relaxed);
+  active.store(workers.size(), std::memory_order_relaxed);
+  OpenLevel(0);
+
+  generation.fetch_add(1, std::memory_order_release);
+  generation.notify_all();
+
+  RunLevels(0);
+
+  while (completed.load(std::memory_order_acquire) != plan->NumKernels() ||
+         active.load(std::memory_order_acquire) != 0) {
+    CpuRelax();
+  }
+}
+
+void ParallelExecutor::WorkerLoop(std::size_t participant) {
+  std::uint64_t seen = 0;
+  while (true) {
+    generation.wait(seen, std::memory_order_acquire);
+    seen = generation.load(std::memory_order_acquire);
+    if (stopping.load()) {
+      return;
+    }
+
+    RunLevels(participant);
+    active.fetch_sub(1, std::memory_order_release);
+  }
+}
+
+void ParallelExecutor::RunLevels(std::size_t participant) {
+  std::size_t num_levels = plan->NumLevels();
+  for (size_t level = 0; level < num_levels; ++level) {
+    while (opened.load(std::memory_order_acquire) <= level) {
+      CpuRelax();
+    }
+
+    // Can also take kernels of the next level if it opens meanwhile.
+    std::size_t kernel = 0;
+    while (TakeKernel(participant, &kernel)) {
+      plan->RunKernel(kernel, info);
+
+      std::size_t kernel_level = plan->LevelOf(kernel);
+      std::size_t done = completed.fetch_add(1, std::memory_order_acq_rel) + 1;
+      if (done == plan->LevelEnd(kernel_level) && kernel_level + 1 < num_levels) {
+        OpenLevel(kernel_level + 1);
+      }
+    }
+  }
+}
+
+void ParallelExecutor::OpenLevel(std::size_t level) {
+  std::size_t num_participants = NumThreads();
+  std::size_t begin = plan->LevelBegin(level);
+  std::size_t size = plan->LevelEnd(level) - begin;
+
+  for (size_t p = 0; p < num_participants; ++p) {
+    std::size_t range_begin = begin + size * p / num_participants;
+    std::size_t range_end = begin + size * (p + 1) / num_participants;
+    ranges[p].packed.store(PackRange(range_begin, range_end), std::memory_order_release);
+  }
+
+  opened.store(level + 1, std::memory_order_release);
+}
+
+bool ParallelExecutor::TakeKernel(std::size_t participant, std::size_t* kernel) {
+  // Own range from the front.
+  auto& own = ranges[participant].packed;
+  std::uint64_t packed = own.load(std::memory_order_acquire);
+  while (RangeBegin(packed) < RangeEnd(packed)) {
+    std::uint64_t next = PackRange(RangeBegin(packed) + 1, RangeEnd(packed));
+    if (own.compare_exchange_weak(packed, next, std::memory_order_acq_rel, std::memory_order_acquire)) {
+      *kernel = RangeBegin(packed);
+      return true;
+    }
+  }
+
+  // Steal from the back of the others.
+  std::size_t num_participants = NumThreads();
+  for (size_t i = 1; i < num_participants; ++i) {
+    auto& victim = ranges[(participant + i) % num_participants].packed;
+    packed = victim.load(std::memory_order_acquire);
+    while (RangeBegin(packed) < RangeEnd(packed)) {
+      std::uint64_t next = PackRange(RangeBegin(packed), RangeEnd(packed) - 1);
+      if (victim.compare_exchange_weak(packed, next, std::memory_order_acq_rel, std::memory_order_acquire)) {
+        *kernel = RangeEnd(packed) - 1;
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
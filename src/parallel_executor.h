@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "execution_plan.h"
+
+// Plans smaller than this, or without two independent kernels on one level,
+// run on the calling thread: synchronization would cost more than it saves.
+const std::size_t kMinParallelKernels = 32;
+
+// Runs execution plans on a pool of worker threads plus the calling thread.
+//
+// Levels of the plan run one after another. Each level is split evenly
+// between participants, each owning a contiguous range of kernels. A
+// participant runs its own range front to back, then steals from the back
+// of the other ranges. A lock-free counter of completed kernels tells when a
+// level is done; the participant completing it opens the next one.
+class ParallelExecutor {
+ public:
+  // num_threads counts the calling thread, so 1 means no workers.
+  // It is capped by the number of cores. Workers are pinned to cores
+  // and get real-time priority when allowed.
+  explicit ParallelExecutor(std::size_t num_threads);
+  ~ParallelExecutor();
+
+  ParallelExecutor(const ParallelExecutor&) = delete;
+  ParallelExecutor& operator= (const ParallelExecutor&) = delete;
+
+  // Blocks until every kernel of the plan ran for this block. The sinks are
+  // left to ExecutionPlan::EndBlock.
+  void Execute(ExecutionPlan& plan, const BlockInfo& info);
+
+  std::size_t NumThreads() const {
+    return workers.size() + 1;
+  }
+
+ private:
+  // Kernel range [begin, end) packed into one word so that owner and
+  // thieves can both update it with a single CAS.
+  struct alignas(64) Range {
+    std::atomic<std::uint64_t> packed = 0;
+  };
+
+  void WorkerLoop(std::size_t participant);
+  void RunLevels(std::size_t participant);
+  void OpenLevel(std::size_t level);
+  bool TakeKernel(std::size_t participant, std::size_t* kernel);
+
+  std::vector<std::thread> workers;
+  std::unique_ptr<Range[]> ranges;  // One per participant
+
+  // Job of the current block, written before generation is bumped.
+  ExecutionPlan* plan = nullptr;
+  BlockInfo info;
+
+  alignas(64) std::atomic<std::uint64_t> generation = 0;
+  alignas(64) std::atomic<std::size_t> completed = 0;   // Kernels done in this block
+  alignas(64) std::atomic<std::size_t> opened = 0;      // Levels open for execution
+  alignas(64) std::atomic<std::size_t> active = 0;      // Workers still in this block
+  std::atomic<bool> stopping = false;
+};
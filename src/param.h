@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "spsc_queue.h"
+
+const std::size_t kParamPayloadSize = 8;
+const std::size_t kParamQueueCapacity = 4096;
+
+class ParamBase;
+
+// New value for one parameter, due at a sample position.
+struct ParamChange {
+  ParamBase* target = nullptr;
+  std::uint64_t time = 0;
+  std::array<std::byte, kParamPayloadSize> payload;
+};
+
+// Carries parameter edits from the GUI thread into the audio thread.
+// Changes must be pushed in non-decreasing time order.
+class ParamQueue {
+ public:
+  explicit ParamQueue(std::size_t capacity = kParamQueueCapacity) : queue(capacity) { }
+
+  // GUI thread. Returns false if the queue is full.
+  bool Push(const ParamChange& change) {
+    return queue.TryPush(change);
+  }
+
+  // Audio thread. Applies every change due at or before position.
+  // Returns how many samples, at most max_size, can be rendered
+  // before the next change is due, so it lands on its exact sample.
+  std::size_t ApplyDue(std::uint64_t position, std::size_t max_size);
+
+  // Total changes pushed and applied. Used to fence snapshot reclamation:
+  // a queued change may point into a node only an old snapshot keeps alive.
+  std::uint64_t NumPushed() const {
+    return queue.NumPushed();
+  }
+
+  std::uint64_t NumApplied() const {
+    return queue.NumPopped();
+  }
+
+ private:
+  SpscQueue<ParamChange> queue;
+};
+
+class ParamBase {
+ public:
+  virtual ~ParamBase() = default;
+
+  // GUI thread. Pushes the value if it was edited since the last flush.
+  // On a full queue the value stays dirty and is retried on the next flush.
+  virtual void Flush(ParamQueue& queue, std::uint64_t time) = 0;
+
+  // Audio thread.
+  virtual void Apply(const std::byte* payload) = 0;
+};
+
+// Node parameter edited on the GUI thread and read on the audio thread.
+// Each thread owns its copy of the value, edits travel through the ParamQueue.
+template <typename T>
+class Param : public ParamBase {
+  static_assert(std::is_trivially_copyable_v<T> && sizeof(T) <= kParamPayloadSize);
+
+ public:
+  Param(T value = T()) : ui(value), dsp(value) { }
+
+  // Sets both copies. Only while the node isn't rendered, e.g. on load.
+  void Reset(T value) {
+    ui = value;
+    dsp = value;
+    dirty = false;
+  }
+
+  // GUI thread. Call after ui was edited.
+  void Touch() {
+    dirty = true;
+  }
+
+  void Flush(ParamQueue& queue, std::uint64_t time) override {
+    if (!dirty) {
+      return;
+    }
+
+    ParamChange change;
+    change.target = this;
+    change.time = time;
+    std::memcpy(change.payload.data(), &ui, sizeof(T));
+    dirty = !queue.Push(change);
+  }
+
+  void Apply(const std::byte* payload) override {
+    std::memcpy(&dsp, payload, sizeof(T));
+  }
+
+  T ui;   // GUI thread copy, bound to widgets.
+  T dsp;  // Audio thread copy.
+
+ private:
+  bool dirty = false;
+};
+
+inline std::size_t ParamQueue::ApplyDue(std::uint64_t position, std::size_t max_size) {
+  while (const ParamChange* change = queue.Front()) {
+    if (change->time > position) {
+      return std::min<std::uint64_t>(max_size, change->time - position);
+    }
+
+    change->target->Apply(change->payload.data());
+    queue.Pop();
+  }
+  return max_size;
+}
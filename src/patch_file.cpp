@@ -0,0 +1,304 @@
+#include "patch_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+std::size_t AlignUp(std::size_t n) {
+  return (n + 7) & ~std::size_t(7);
+}
+
+// Table of count T at offset, if it lies inside size bytes.
+template <typename T>
+bool GetTable(const std::uint8_t* base, std::size_t size, std::uint64_t offset, std::uint64_t count,
+              std::span<const T>* table) {
+  REQ_CHECK_EX(offset % alignof(T) == 0, "Patch: Misaligned table");
+  REQ_CHECK_EX(offset <= size && count <= (size - offset) / sizeof(T), "Patch: Table out of bounds");
+  *table = std::span<const T>(reinterpret_cast<const T*>(base + offset), count);
+  return true;
+}
+
+bool BlobInside(const PatchBlob& blob, std::size_t blobs_size) {
+  return blob.offset <= blobs_size && blob.size <= blobs_size - blob.offset;
+}
+
+}  // namespace
+
+bool PatchView::Open(const void* data, std::size_t size) {
+  auto* base = static_cast<const std::uint8_t*>(data);
+  REQ_CHECK_EX(size >= sizeof(PatchHeader), "Patch: Truncated");
+  REQ_CHECK_EX(reinterpret_cast<std::uintptr_t>(base) % alignof(PatchHeader) == 0, "Patch: Misaligned data");
+
+  const auto& header = *reinterpret_cast<const PatchHeader*>(base);
+  REQ_CHECK_EX(std::memcmp(header.magic, kPatchMagic, sizeof(kPatchMagic)) == 0, "Patch: Not a binary patch");
+  REQ_CHECK_EX(header.version == kPatchVersion, "Patch: Unsupported version " << header.version);
+
+  REQ_CHECK(GetTable(base, size, header.types_offset, header.num_types, &types));
+  REQ_CHECK(GetTable(base, size, header.nodes_offset, header.num_nodes, &nodes));
+  REQ_CHECK(GetTable(base, size, header.links_offset, header.num_links, &links));
+  REQ_CHECK(GetTable(base, size, header.blobs_offset, header.blobs_size, &blobs));
+
+  for (const auto& type : types) {
+    REQ_CHECK_EX(BlobInside(type, blobs.size()), "Patch: Type name out of bounds");
+  }
+  for (const auto& node : nodes) {
+    REQ_CHECK_EX(node.type < types.size(), "Patch: Node type index");
+    REQ_CHECK_EX(BlobInside(node.params, blobs.size()), "Patch: Params out of bounds");
+  }
+  for (const auto& link : links) {
+    REQ_CHECK_EX(link.src < nodes.size() && link.dst < nodes.size(), "Patch: Link node index");
+  }
+  return true;
+}
+
+std::string_view PatchView::GetTypeName(std::uint32_t type) const {
+  auto blob = GetBlob(types[type]);
+  return std::string_view(reinterpret_cast<const char*>(blob.data()), blob.size());
+}
+
+std::uint32_t PatchWriter::AddNode(std::int32_t id, const std::string& type, float pos_x, float pos_y,
+                                   const nlohmann::json& params) {
+  auto [it, inserted] = type_index.try_emplace(type, static_cast<std::uint32_t>(types.size()));
+  if (inserted) {
+    types.push_back(AddBlob({reinterpret_cast<const std::uint8_t*>(type.data()), type.size()}));
+  }
+
+  auto cbor = nlohmann::json::to_cbor(params);
+  nodes.push_back(PatchNode{
+    .id = id,
+    .type = it->second,
+    .pos_x = pos_x,
+    .pos_y = pos_y,
+    .params = AddBlob(cbor)});
+  return static_cast<std::uint32_t>(nodes.size() - 1);
+}
+
+void PatchWriter::AddLink(std::uint32_t src, int out_idx, std::uint32_t dst, int in_idx) {
+  links.push_back(PatchLink{.src = src, .out_idx = out_idx, .dst = dst, .in_idx = in_idx});
+}
+
+PatchBlob PatchWriter::AddBlob(std::span<const std::uint8_t> bytes) {
+  ASSERT(blobs.size() + bytes.size() <= UINT32_MAX);
+  PatchBlob blob{static_cast<std::uint32_t>(blobs.size()), static_cast<std::uint32_t>(bytes.size())};
+  blobs.insert(blobs.end(), bytes.begin(), bytes.end());
+  return blob;
+}
+
+std::vector<std::uint8_t> PatchWriter::Finish() const {
+  PatchHeader header{};
+  std::memcpy(header.magic, kPatchMagic, sizeof(kPatchMagic));
+  header.version = kPatchVersion;
+  header.num_types = static_cast<std::uint32_t>(types.size());
+  header.num_nodes = static_cast<std::uint32_t>(nodes.size());
+  header.num_links = static_cast<std::uint32_t>(links.size());
+  header.types_offset = AlignUp(sizeof(PatchHeader));
+  header.nodes_offset = AlignUp(header.types_offset + types.size() * sizeof(PatchBlob));
+  header.links_offset = AlignUp(header.nodes_offset + nodes.size() * sizeof(PatchNode));
+  header.blobs_offset = AlignUp(header.links_offset + links.size() * sizeof(PatchLink));
+  header.blobs_size = blobs.size();
+
+  std::vector<std::uint8_t> out(header.blobs_offset + blobs.size(), 0);
+  auto put = [&out] (std::uint64_t offset, const void* src, std::size_t n) {
+    if (n > 0) {
+      std::memcpy(out.data() + offset, src, n);
+    }
+  };
+  put(0, &header, sizeof(header));
+  put(header.types_offset, types.data(), types.size() * sizeof(PatchBlob));
+  put(header.nodes_offset, nodes.data(), nodes.size() * sizeof(PatchNode));
+  put(header.links_offset, links.data(), links.size() * sizeof(PatchLink));
+  put(header.blobs_offset, blobs.data(), blobs.size());
+  return out;
+}
+
+MappedFile::~MappedFile() {
+  if (data) {
+    munmap(data, size);
+  }
+}
+
+bool MappedFile::Open(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  REQ_CHECK_EX(fd >= 0, "Can't open " << path);
+
+  struct stat st;
+  bool ok = fstat(fd, &st) == 0 && st.st_size > 0;
+  if (ok) {
+    size = static_cast<std::size_t>(st.st_size);
+    data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      data = nullptr;
+      ok = false;
+    }
+  }
+  // The mapping stays valid after close.
+  close(fd);
+  REQ_CHECK_EX(ok, "Can't map " << path);
+  return true;
+}
+
+std::vector<std::uint8_t> SavePatch(const Multigraph& g) {
+  NodeNames names;
+  PatchWriter writer;
+  std::vector<std::uint32_t> node_index(g.GetNodes().NumSlots());  // By node slot index
+
+  for (auto& [node_id, wrapper] : g.GetNodes()) {
+    auto params = nlohmann::json::object();
+    wrapper.node->Save(params);
+    node_index[node_id.index] = writer.AddNode(
+      static_cast<std::int32_t>(node_id.index), names.GetName(wrapper.node->GetType()), wrapper.attrs->pos_x, wrapper.attrs->pos_y, params);
+  }
+
+  auto& pins = g.GetPins();
+  for (auto& [link_id, link_pins] : g.GetLinks().link_id_to_pins) {
+    auto pin_src = pins.GetPinById(link_pins.first);
+    auto pin_dst = pins.GetPinById(link_pins.second);
+    writer.AddLink(
+      node_index[pin_src->node_id.index], pin_src->node_io_id,
+      node_index[pin_dst->node_id.index], pin_dst->node_io_id);
+  }
+  return writer.Finish();
+}
+
+bool LoadPatch(Multigraph& g, const PatchView& patch, const NodeFactory& factory) {
+  NodeNames names;
+
+  // Type names are looked up once per type, not per node.
+  std::vector<NodeType> types;
+  types.reserve(patch.NumTypes());
+  // Patches from a newer version may name types this one doesn't have.
+  for (std::uint32_t i = 0; i < patch.NumTypes(); ++i) {
+    std::string name(patch.GetTypeName(i));
+    REQ_CHECK_EX(names.HasType(name), "LoadPatch: Unknown node type " << name);
+    types.push_back(names.GetType(name));
+  }
+
+  GraphBatch batch;
+  batch.nodes.reserve(patch.GetNodes().size());
+  for (const auto& patch_node : patch.GetNodes()) {
+    NodeWrapper wrapper;
+    wrapper.node = factory.CreateNode(types[patch_node.type]);
+    wrapper.node->Load(nlohmann::json::from_cbor(patch.GetBlob(patch_node.params)));
+    wrapper.attrs = std::make_shared<NodeAttributes>();
+    wrapper.attrs->is_placed = false;
+    wrapper.attrs->pos_x = patch_node.pos_x;
+    wrapper.attrs->pos_y = patch_node.pos_y;
+    batch.AddNode(std::move(wrapper));
+  }
+
+  // Node indices of the patch are batch indices as they are.
+  batch.links.reserve(patch.GetLinks().size());
+  for (const auto& link : patch.GetLinks()) {
+    batch.AddLink(link.src, link.out_idx, link.dst, link.in_idx);
+  }
+
+  return g.AddBatch(batch);
+}
+
+bool JsonToPatch(const nlohmann::json& j, std::vector<std::uint8_t>* patch) {
+  PatchWriter writer;
+  std::map<int, std::uint32_t> node_index;
+
+  auto& j_nodes = JsonGetConstRef(j, "nodes");
+  REQ_CHECK_EX(j_nodes.is_array(), "JsonToPatch: nodes");
+  for (auto& j_node : j_nodes) {
+    int id = JsonGetValue<int>(j_node, "id");
+    auto& attributes = JsonGetConstRef(j_node, "attributes");
+    REQ_CHECK_EX(!node_index.contains(id), "JsonToPatch: Duplicate node id " << id);
+    node_index[id] = writer.AddNode(
+      id, JsonGetValue<std::string>(j_node, "type"),
+      JsonGetValue<float>(attributes, "x"), JsonGetValue<float>(attributes, "y"),
+      JsonGetConstRef(j_node, "params"));
+  }
+
+  auto& j_links = JsonGetConstRef(j, "links");
+  REQ_CHECK_EX(j_links.is_array(), "JsonToPatch: links");
+  for (auto& j_link : j_links) {
+    REQ_CHECK_EX(j_link.is_array() && j_link.size() == 4, "JsonToPatch: link");
+    auto src = node_index.find(j_link.at(0).get<int>());
+    auto dst = node_index.find(j_link.at(2).get<int>());
+    REQ_CHECK_EX(src != node_index.end() && dst != node_index.end(), "JsonToPatch: Unknown node in link");
+    writer.AddLink(src->second, j_link.at(1).get<int>(), dst->second, j_link.at(3).get<int>());
+  }
+
+  *patch = writer.Finish();
+  return true;
+}
+
+bool PatchToJson(const PatchView& patch, nlohmann::json& j) {
+  using namespace nlohmann;
+  auto& j_nodes = j["nodes"] = json::array();
+  auto& j_links = j["links"] = json::array();
+
+  auto nodes = patch.GetNodes();
+  for (const auto& node : nodes) {
+    auto j_node = json::object();
+    j_node["id"] = node.id;
+    j_node["type"] = std::string(patch.GetTypeName(node.type));
+    j_node["params"] = json::from_cbor(patch.GetBlob(node.params));
+    j_node["attributes"] = json::object();
+    JsonSetValue(j_node["attributes"], "x", node.pos_x);
+    JsonSetValue(j_node["attributes"], "y", node.pos_y);
+    j_nodes.push_back(std::move(j_node));
+  }
+
+  for (const auto& link : patch.GetLinks()) {
+    j_links.push_back(json::array({nodes[link.src].id, link.out_idx, nodes[link.dst].id, link.in_idx}));
+  }
+  return true;
+}
+
+bool IsBinaryPatch(const std::string& path) {
+  std::ifstream f(path, std::ios::binary);
+  char magic[sizeof(kPatchMagic)] = {};
+  f.read(magic, sizeof(magic));
+  return f && std::memcmp(magic, kPatchMagic, sizeof(kPatchMagic)) == 0;
+}
+
+bool LoadPatchFile(Multigraph& g, const std::string& path, const NodeFactory& factory) {
+  if (IsBinaryPatch(path)) {
+    MappedFile file;
+    PatchView patch;
+    REQ_CHECK(file.Open(path));
+    REQ_CHECK(patch.Open(file.GetData(), file.GetSize()));
+    try {
+      return LoadPatch(g, patch, factory);
+    } catch (const nlohmann::json::exception& e) {
+      std::cout << "Bad params in " << path << ": " << e.what() << std::endl;
+      return false;
+    }
+  }
+
+  std::ifstream f(path);
+  REQ_CHECK_EX(f.is_open(), "Can't open " << path);
+  nlohmann::json j;
+  try {
+    f >> j;
+  } catch (const nlohmann::json::exception& e) {
+    std::cout << "Can't parse " << path << ": " << e.what() << std::endl;
+    return false;
+  }
+  return LoadGraph(g, j, factory);
+}
+
+bool SavePatchFile(const Multigraph& g, const std::string& path) {
+  std::ofstream f(path, std::ios::binary);
+  REQ_CHECK_EX(f.is_open(), "Can't write " << path);
+
+  if (path.ends_with(kPatchExtension)) {
+    auto patch = SavePatch(g);
+    f.write(reinterpret_cast<const char*>(patch.data()), patch.size());
+  } else {
+    auto j = nlohmann::json::object();
+    SaveGraph(g, j);
+    f << j;
+  }
+  return f.good();
+}
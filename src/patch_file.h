@@ -0,0 +1,159 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <map>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "multigraph.h"
+#include "node_factory.h"
+
+#include "json.hpp"
+
+// Binary patches, the same content as SaveGraph() JSON laid out as tables
+// that are used where they lie, typically in an mmap()ed file:
+//
+//   PatchHeader
+//   PatchBlob[num_types]   node type names
+//   PatchNode[num_nodes]
+//   PatchLink[num_links]   nodes by their index in the node table
+//   blobs                  type names, then node params as CBOR
+//
+// Little endian, every section 8 byte aligned. Readers reject any other
+// version, bump kPatchVersion on every layout change.
+
+static_assert(std::endian::native == std::endian::little, "Binary patches are little endian");
+
+constexpr char kPatchMagic[8] = {'S', 'Y', 'N', 'P', 'A', 'T', 'C', 'H'};
+constexpr std::uint32_t kPatchVersion = 1;
+
+struct PatchHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t num_types;
+  std::uint32_t num_nodes;
+  std::uint32_t num_links;
+  std::uint64_t types_offset;
+  std::uint64_t nodes_offset;
+  std::uint64_t links_offset;
+  std::uint64_t blobs_offset;
+  std::uint64_t blobs_size;
+};
+
+// Bytes in the blob section.
+struct PatchBlob {
+  std::uint32_t offset;
+  std::uint32_t size;
+};
+
+struct PatchNode {
+  std::int32_t id;  // As saved, only kept for the JSON conversion
+  std::uint32_t type;  // Index in the type table
+  float pos_x;
+  float pos_y;
+  PatchBlob params;
+};
+
+struct PatchLink {
+  std::uint32_t src;
+  std::int32_t out_idx;
+  std::uint32_t dst;
+  std::int32_t in_idx;
+};
+
+// Read-only view of a binary patch. Open() checks the header and that all
+// tables and blobs lie inside the data, after that nothing is copied or
+// checked again. The data has to outlive the view.
+class PatchView {
+ public:
+  bool Open(const void* data, std::size_t size);
+
+  std::span<const PatchNode> GetNodes() const {
+    return nodes;
+  }
+
+  std::span<const PatchLink> GetLinks() const {
+    return links;
+  }
+
+  std::size_t NumTypes() const {
+    return types.size();
+  }
+
+  std::string_view GetTypeName(std::uint32_t type) const;
+
+  std::span<const std::uint8_t> GetBlob(const PatchBlob& blob) const {
+    return blobs.subspan(blob.offset, blob.size);
+  }
+
+ private:
+  std::span<const PatchBlob> types;
+  std::span<const PatchNode> nodes;
+  std::span<const PatchLink> links;
+  std::span<const std::uint8_t> blobs;
+};
+
+// Lays out a binary patch. Nodes get indices in the order they are added.
+class PatchWriter {
+ public:
+  std::uint32_t AddNode(std::int32_t id, const std::string& type, float pos_x, float pos_y,
+                        const nlohmann::json& params);
+  void AddLink(std::uint32_t src, int out_idx, std::uint32_t dst, int in_idx);
+
+  std::vector<std::uint8_t> Finish() const;
+
+ private:
+  PatchBlob AddBlob(std::span<const std::uint8_t> bytes);
+
+  std::vector<PatchBlob> types;
+  std::map<std::string, std::uint32_t> type_index;
+  std::vector<PatchNode> nodes;
+  std::vector<PatchLink> links;
+  std::vector<std::uint8_t> blobs;
+};
+
+// Read-only mapping of a whole file.
+class MappedFile {
+ public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator= (const MappedFile&) = delete;
+
+  bool Open(const std::string& path);
+
+  const void* GetData() const {
+    return data;
+  }
+
+  std::size_t GetSize() const {
+    return size;
+  }
+
+ private:
+  void* data = nullptr;
+  std::size_t size = 0;
+};
+
+std::vector<std::uint8_t> SavePatch(const Multigraph& g);
+
+// Adds the patch to g as one batch, see LoadGraph().
+bool LoadPatch(Multigraph& g, const PatchView& patch, const NodeFactory& factory);
+
+// Lossless both ways for what SaveGraph() writes.
+bool JsonToPatch(const nlohmann::json& j, std::vector<std::uint8_t>* patch);
+bool PatchToJson(const PatchView& patch, nlohmann::json& j);
+
+// True if the file starts like a binary patch.
+bool IsBinaryPatch(const std::string& path);
+
+// Loads either format, binary patches through mmap().
+bool LoadPatchFile(Multigraph& g, const std::string& path, const NodeFactory& factory);
+
+// Binary for paths ending in kPatchExtension, JSON otherwise.
+constexpr std::string_view kPatchExtension = ".synp";
+bool SavePatchFile(const Multigraph& g, const std::string& path);
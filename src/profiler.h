@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Per-node CPU time, on unless the build sets SYNTH_PROFILING=0. When off,
+// every timing site is discarded at compile time.
+#if !defined(SYNTH_PROFILING) || SYNTH_PROFILING
+constexpr bool kProfilingEnabled = true;
+#else
+constexpr bool kProfilingEnabled = false;
+#endif
+
+// Cheapest monotonic counter available: the TSC on x86, which ticks at a
+// constant rate on anything recent, nanoseconds elsewhere.
+inline std::uint64_t ReadCycles() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// ReadCycles() ticks per second, measured once against the steady clock.
+// Blocks for about 20 ms on first call, so call it off the audio thread.
+inline double CyclesPerSecond() {
+  static const double rate = [] {
+    using Clock = std::chrono::steady_clock;
+    auto start_time = Clock::now();
+    std::uint64_t start = ReadCycles();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    std::uint64_t cycles = ReadCycles() - start;
+    return cycles / std::chrono::duration<double>(Clock::now() - start_time).count();
+  }();
+  return rate;
+}
+
+// Running totals, written only by the thread running the owner and read by
+// anyone. Readers take differences between two snapshots.
+struct CycleCounter {
+  std::atomic<std::uint64_t> cycles = 0;
+  std::atomic<std::uint64_t> calls = 0;
+
+  void Add(std::uint64_t elapsed) {
+    cycles.store(cycles.load(std::memory_order_relaxed) + elapsed, std::memory_order_relaxed);
+    calls.store(calls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  std::uint64_t Cycles() const {
+    return cycles.load(std::memory_order_relaxed);
+  }
+
+  std::uint64_t Calls() const {
+    return calls.load(std::memory_order_relaxed);
+  }
+};
+
+// Times f() into counter, or just calls it when profiling is compiled out.
+template <typename F>
+inline void Profiled(CycleCounter& counter, F&& f) {
+  if constexpr (kProfilingEnabled) {
+    std::uint64_t start = ReadCycles();
+    f();
+    counter.Add(ReadCycles() - start);
+  } else {
+    f();
+  }
+}
+
+// Times a run of consecutive calls with one counter read between each
+// instead of two around each. Whatever runs between calls is billed to the
+// next one.
+class ProfiledSequence {
+ public:
+  ProfiledSequence() {
+    if constexpr (kProfilingEnabled) {
+      last = ReadCycles();
+    }
+  }
+
+  template <typename F>
+  void Run(CycleCounter& counter, F&& f) {
+    f();
+    if constexpr (kProfilingEnabled) {
+      std::uint64_t now = ReadCycles();
+      counter.Add(now - last);
+      last = now;
+    }
+  }
+
+ private:
+  std::uint64_t last = 0;
+};
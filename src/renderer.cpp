@@ -0,0 +1,44 @@
+#include "renderer.h"
+
+#include <algorithm>
+
+Renderer::Renderer(std::shared_ptr<Multigraph> graph, std::size_t num_threads)
+    : graph(std::move(graph))
+    , output(std::make_shared<AudioOutput>())
+    , executor(num_threads) {
+}
+
+void Renderer::Render(float* out, std::size_t n) {
+  Profiled(profile, [&] { RenderFrames(out, n); });
+}
+
+void Renderer::RenderFrames(float* out, std::size_t n) {
+  // Plan stays alive until the guard is released. Never blocks.
+  auto plan = graph->AcquirePlan();
+  auto& params = graph->GetParamQueue();
+  std::uint64_t current = position.load(std::memory_order_relaxed);
+
+  for (size_t offset = 0; offset < n;) {
+    // A change due inside the block splits it to land on its exact sample.
+    size_t max_size = std::min(kMaxBlockSize, n - offset);
+
+    BlockInfo info;
+    info.position = current;
+    info.time = SampleTimestamp(current);
+    info.dt = 1.0f / kSampleRate;
+    info.size = params.ApplyDue(current, max_size);
+    plan->BeginBlock(params.NumApplied(), info);
+
+    // Silence unless an output node writes the block.
+    for (auto& channel : output->block) {
+      std::fill_n(channel.begin(), info.size, 0.0f);
+    }
+    executor.Execute(*plan.get(), info);
+    plan->EndBlock(info);
+    InterleaveBlock(*output, info.size, out + offset * kNumChannels);
+
+    offset += info.size;
+    current += info.size;
+    position.store(current, std::memory_order_relaxed);
+  }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "multigraph.h"
+#include "output.h"
+#include "parallel_executor.h"
+#include "profiler.h"
+
+// Renders the graph into float samples, block by block, and owns the
+// sample clock. Shared by the audio thread and the offline tools.
+class Renderer {
+ public:
+  // num_threads as in ParallelExecutor.
+  explicit Renderer(std::shared_ptr<Multigraph> graph, std::size_t num_threads = 1);
+
+  // Renders the next n frames into out, kNumChannels interleaved samples
+  // each. Blocks are split so that queued parameter changes land on their
+  // exact sample. Never blocks on edits.
+  void Render(float* out, std::size_t n);
+
+  // Where the audio output nodes of the graph write to.
+  std::shared_ptr<AudioOutput> GetOutput() {
+    return output;
+  }
+
+  // Sample clock: position of the next sample. Safe to call from any thread.
+  std::uint64_t GetPosition() const {
+    return position.load(std::memory_order_relaxed);
+  }
+
+  float GetTimestamp() const {
+    return SampleTimestamp(GetPosition());
+  }
+
+  std::size_t NumThreads() const {
+    return executor.NumThreads();
+  }
+
+  // Time spent in Render(), for the DSP load. Per node times are kept by
+  // the nodes themselves.
+  const CycleCounter& GetProfile() const {
+    return profile;
+  }
+
+ private:
+  void RenderFrames(float* out, std::size_t n);
+
+  std::shared_ptr<Multigraph> graph;
+  std::shared_ptr<AudioOutput> output;
+  ParallelExecutor executor;
+  std::atomic<std::uint64_t> position = 0;
+  CycleCounter profile;
+};
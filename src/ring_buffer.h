@@ -1,104 +1,115 @@
 #pragma once
 
-#include <cassert>
-#include <vector>
-#include <memory>
+#include <algorithm>
 #include <atomic>
+#include <cstdint>
 #include <span>
+#include <vector>
 
 #include "util.h"
 
 
-// Implementation of a nonblocking ring buffer.
-// It uses strong memory order assumption, so probably
-// only works correctly on X86 CPU.
+// Wait-free single producer, single consumer ring buffer.
+// Size is rounded up to a power of two so positions wrap with a mask.
+// Positions only grow, each side owns one and publishes it with release
+// ordering. They live on separate cache lines together with the owner's
+// last seen copy of the other side, which Reserve() trusts while it has
+// room enough.
 template <typename T>
 class RingBuffer {
  public:
-  explicit RingBuffer(std::size_t size)
-      : size_(size), data_(size) {
-    read_position_.store(0);
-    write_position_.store(0);
-  }
-
-  // Write N bytes from current position. 
-  // N must be <= size.
-  // src must contain atleast N elements.
-  void Write(const std::vector<T>& src, std::size_t n) {
-    ASSERT(n <= size_);
-    auto head = write_position_.load();
-    auto position = head % size_;
-
-    if (n > size_ - position) {
-      std::size_t part_size = size_ - position;
-      std::copy(src.begin(), src.begin() + part_size, data_.begin() + position);
-      std::copy(src.begin() + part_size, src.begin() + n, data_.begin());
-    } else {
-      std::copy(src.begin(), src.begin() + n, data_.begin() + position);
+  explicit RingBuffer(std::size_t size) {
+    std::size_t capacity = 1;
+    while (capacity < size) {
+      capacity *= 2;
     }
+    mask_ = capacity - 1;
+    data_.resize(capacity);
+  }
 
-    write_position_.store(head + n);
+  // Producer only. Room for writing in place: up to n elements, contiguous,
+  // so it can be shorter than n at the end of the storage. Fill it and
+  // Commit() what was written.
+  std::span<T> Reserve(std::size_t n) {
+    n = std::min(n, Room(n));
+    std::size_t offset = producer_.position.load(std::memory_order_relaxed) & mask_;
+    return std::span<T>(data_.data() + offset, std::min(n, Size() - offset));
   }
 
-  // Read N elements into dst. Assume dst already resized to atleast N.
-  void Read(std::vector<T>& dst, std::size_t n) {
-    auto head = read_position_.load();
-    auto position = head % size_;
-    if (n > size_ - position) {
-      std::copy(data_.begin() + position, data_.end(), dst.begin());
-      std::size_t num_copied = size_ - position;
-      std::size_t remaining = n - num_copied;
-      std::copy(data_.begin(), data_.begin() + remaining, dst.begin() + num_copied);
-    } else {
-      std::copy(data_.begin() + position, data_.begin() + position + n, dst.begin());
-    }
+  // Producer only. Publishes n elements written into Reserve()d space.
+  void Commit(std::size_t n) {
+    std::uint64_t head = producer_.position.load(std::memory_order_relaxed);
+    HOT_ASSERT(n <= Size() - (head - producer_.other));
+    producer_.position.store(head + n, std::memory_order_release);
+  }
 
-    read_position_.store(head + n);
+  // Producer only. Copies n elements in, n must be <= ReadyToWrite().
+  void Write(std::span<const T> src, std::size_t n) {
+    HOT_ASSERT(n <= src.size() && n <= Room(n));
+    std::uint64_t head = producer_.position.load(std::memory_order_relaxed);
+    std::size_t offset = head & mask_;
+    std::size_t first = std::min(n, Size() - offset);
+    std::copy_n(src.begin(), first, data_.begin() + offset);
+    std::copy_n(src.begin() + first, n - first, data_.begin());
+    producer_.position.store(head + n, std::memory_order_release);
   }
 
+  // Consumer only. Copies n elements out, n must be <= ReadyToRead().
   void Read(T* dst, std::size_t n) {
-    std::span<T> sp(dst, n);
-    auto head = read_position_.load();
-    auto position = head % size_;
-    if (n > size_ - position) {
-      std::copy(data_.begin() + position, data_.end(), sp.begin());
-      std::size_t num_copied = size_ - position;
-      std::size_t remaining = n - num_copied;
-      std::copy(data_.begin(), data_.begin() + remaining, sp.begin() + num_copied);
-    } else {
-      std::copy(data_.begin() + position, data_.begin() + position + n, sp.begin());
-    }
-
-    read_position_.store(head + n);
+    HOT_ASSERT(n <= Available(n));
+    std::uint64_t tail = consumer_.position.load(std::memory_order_relaxed);
+    std::size_t offset = tail & mask_;
+    std::size_t first = std::min(n, Size() - offset);
+    std::copy_n(data_.begin() + offset, first, dst);
+    std::copy_n(data_.begin(), n - first, dst + first);
+    consumer_.position.store(tail + n, std::memory_order_release);
   }
 
-  // This many elements can be read when the function is called.
-  // If you read more, result could be undefined.
-  std::size_t ReadyToRead() const {
-    return write_position_.load() - read_position_.load();
+  // Consumer only. Elements that can be read now, more may arrive.
+  std::size_t ReadyToRead() {
+    consumer_.other = producer_.position.load(std::memory_order_acquire);
+    return consumer_.other - consumer_.position.load(std::memory_order_relaxed);
   }
 
-  // This much data can be written when the function is called.
-  // If you write more, you may run into conflict with the reader.
-  std::size_t ReadyToWrite() const {
-    std::size_t delta = write_position_.load() - read_position_.load();
-    assert(delta <= size_);
-    return size_ - delta;
+  // Producer only. Elements that can be written now, more may free up.
+  std::size_t ReadyToWrite() {
+    producer_.other = consumer_.position.load(std::memory_order_acquire);
+    return Size() - (producer_.position.load(std::memory_order_relaxed) - producer_.other);
   }
 
-  // Size of the buffer. It can't be changed.
+  // Size of the buffer, a power of two. It can't be changed.
   std::size_t Size() const {
-    return size_;
+    return mask_ + 1;
   }
 
   // Current write head position. It always increases when new data is written.
-  std::size_t Position() const {
-    return write_position_.load();
+  // 64 bit so that it never wraps, it doubles as the engine sample clock.
+  std::uint64_t Position() const {
+    return producer_.position.load(std::memory_order_acquire);
   }
 
  private:
-  const std::size_t size_;
+  // Room and data as last seen, looked up again only if short of n.
+  std::size_t Room(std::size_t n) {
+    std::uint64_t head = producer_.position.load(std::memory_order_relaxed);
+    std::size_t room = Size() - (head - producer_.other);
+    return room < n ? ReadyToWrite() : room;
+  }
+
+  std::size_t Available(std::size_t n) {
+    std::uint64_t tail = consumer_.position.load(std::memory_order_relaxed);
+    std::size_t available = consumer_.other - tail;
+    return available < n ? ReadyToRead() : available;
+  }
+
+  struct alignas(64) Side {
+    std::atomic<std::uint64_t> position = 0;
+    std::uint64_t other = 0;  // Last seen position of the other side
+  };
+
   std::vector<T> data_;
-  std::atomic<std::size_t> read_position_;
-  std::atomic<std::size_t> write_position_;
+  std::size_t mask_;
+
+  Side producer_;
+  Side consumer_;
 };
@@ -0,0 +1,83 @@
+#include "util.h"
+#include "rtaudio_backend.h"
+
+int RtAudioBackend::Callback( void *outputBuffer, void * /*inputBuffer*/, unsigned int nBufferFrames,
+         double /*streamTime*/, RtAudioStreamStatus status, void *data ) {
+  RtAudioBackend* backend = static_cast<RtAudioBackend*>(data);
+
+  // No printing here, the GUI and the headless summary report it.
+  if (status & RTAUDIO_OUTPUT_UNDERFLOW) {
+    backend->telemetry.RecordDeviceXrun();
+  }
+
+  backend->Pull(outputBuffer, nBufferFrames);
+  return 0;
+}
+
+
+RtAudioBackend::RtAudioBackend(std::size_t buf_size, std::size_t period, SampleFormat format, bool dither) 
+  : OutputBackend(buf_size, format, dither) {
+  if (dac.getDeviceCount() < 1) {
+    std::cout << "No output device" << std::endl;
+    return;
+  }
+  
+  // The device may pick another size, the callback takes what it gets.
+  unsigned int _buf_size = static_cast<unsigned int>(period);
+  
+  RtAudio::StreamParameters params;
+  params.deviceId = dac.getDefaultOutputDevice();
+  params.nChannels = kNumChannels;
+
+  if (format == SampleFormat::kFloat32 &&
+      !(dac.getDeviceInfo(params.deviceId).nativeFormats & RTAUDIO_FLOAT32)) {
+    std::cout << "Device doesn't take float samples, converting to 16 bit" << std::endl;
+    this->format = SampleFormat::kInt16;
+  }
+
+  RtAudio::StreamOptions options;
+  options.flags = 0;
+
+  try {
+    dac.openStream(
+      /*output_params*/&params, 
+      /*input_params*/NULL, 
+      /*format*/this->format == SampleFormat::kFloat32 ? RTAUDIO_FLOAT32 : RTAUDIO_SINT16, 
+      /*sample_rate*/kSampleRate, 
+      &_buf_size, 
+      &RtAudioBackend::Callback, 
+      this,
+      &options);
+    std::cout << "Actual buf size: " << _buf_size << std::endl;
+    ReserveFrames(_buf_size);
+    dac.startStream();
+  }
+  catch (RtAudioError& e ) {
+    e.printMessage();
+    if (dac.isStreamOpen()) dac.closeStream();
+  }
+}
+
+void RtAudioBackend::Start() {
+  if (IsOpen() && !IsPlaying()) {
+    dac.startStream();
+  }
+}
+
+void RtAudioBackend::Stop() {
+  if (IsPlaying()) {
+    dac.stopStream();
+  }
+}
+
+bool RtAudioBackend::IsPlaying() const {
+  return dac.isStreamRunning();
+}
+
+bool RtAudioBackend::IsOpen() const {
+  return dac.isStreamOpen();
+}
+
+RtAudioBackend::~RtAudioBackend() {
+  if (dac.isStreamOpen()) dac.closeStream();
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "backend.h"
+
+#include "rtaudio/RtAudio.h"
+
+// Plays through the default output device, the RtAudio callback drains
+// the buffer or renders in place. period is the requested callback size.
+// Float32 falls back to 16 bit if the device doesn't support it natively.
+class RtAudioBackend : public OutputBackend {
+ public:
+  RtAudioBackend(std::size_t buf_size, std::size_t period, SampleFormat format, bool dither);
+  ~RtAudioBackend() override;
+
+  void Start() override;
+  void Stop() override;
+  bool IsPlaying() const override;
+  const char* GetName() const override { return "rtaudio"; }
+
+  // False when there is no device or the stream failed to open.
+  bool IsOpen() const;
+
+ private:
+  static int Callback(void* outputBuffer, void* inputBuffer, unsigned int nBufferFrames,
+                      double streamTime, RtAudioStreamStatus status, void* data);
+
+  RtAudio dac;
+};
@@ -0,0 +1,25 @@
+#include "simd/kernels.h"
+
+namespace {
+
+const BlockKernels* SelectKernels() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  // The CPU check comes first: GetAvx2Kernels() is compiled for AVX2 and
+  // may use it already to build its table.
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && GetAvx2Kernels()) {
+    return GetAvx2Kernels();
+  }
+#endif
+  if (GetSse2Kernels()) {
+    return GetSse2Kernels();
+  }
+  return GetScalarKernels();
+}
+
+}  // namespace
+
+const BlockKernels& GetBlockKernels() {
+  static const BlockKernels* kernels = SelectKernels();
+  return *kernels;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Elementwise op of the kernels below, as described by a pure node.
+// Lets the execution plan run chains of such nodes as one kernel.
+struct ElementwiseOp {
+  enum Kind {
+    kAdd3,       // add3(in 0, in 1, in 2)
+    kMultiply,   // multiply(in 0, in 1)
+    kMix,        // mix(in 0, in 1, in 2)
+    kMixScalar,  // mix_scalar(in 0, in 1, *param)
+    kClamp,      // clamp(in 0, in 1, in 2)
+    kNegate      // negate(in 0)
+  };
+
+  Kind kind;
+  const float* param = nullptr;  // Read every call, may change between calls.
+
+  static constexpr std::size_t NumInputs(Kind kind) {
+    switch (kind) {
+      case kNegate:
+        return 1;
+      case kMultiply:
+      case kMixScalar:
+        return 2;
+      default:
+        return 3;
+    }
+  }
+
+  std::size_t NumInputs() const {
+    return NumInputs(kind);
+  }
+};
+
+// Samples per pass of run_fused, a multiple of every vector width.
+const std::size_t kFusedChunk = 16;
+
+// One op of run_fused. A pass over samples [i, i + size) reads in[k] +
+// i * in_stride[k] and writes out + i * out_stride: stride 1 for buffers,
+// 0 for the temporaries that pass results between steps, which hold
+// kFusedChunk samples and are overwritten by every pass. Unused inputs
+// stay nullptr.
+struct FusedStep {
+  ElementwiseOp op;
+  const float* in[3] = {};
+  std::size_t in_stride[3] = {};
+  float* out = nullptr;
+  std::size_t out_stride = 0;
+};
+
+// Elementwise float kernels used by node ProcessBlock implementations and
+// the output stage. Buffers may alias as long as out == an input, except
+// for the interleaving and conversion kernels. n is any size, tails are
+// handled by the scalar path.
+struct BlockKernels {
+  const char* name;
+
+  // out = a + b + c
+  void (*add3)(const float* a, const float* b, const float* c, float* out, std::size_t n);
+  // out = a * b
+  void (*multiply)(const float* a, const float* b, float* out, std::size_t n);
+  // out = a * k
+  void (*scale)(const float* a, float k, float* out, std::size_t n);
+  // out = a * (1 - alpha) + b * alpha
+  void (*mix)(const float* a, const float* b, const float* alpha, float* out, std::size_t n);
+  void (*mix_scalar)(const float* a, const float* b, float alpha, float* out, std::size_t n);
+  // out = min(max(x, lo), hi), same as std::clamp for lo <= hi
+  void (*clamp)(const float* x, const float* lo, const float* hi, float* out, std::size_t n);
+  // out = -x
+  void (*negate)(const float* x, float* out, std::size_t n);
+  // out = sin(2 * pi * turns). Absolute error below 1e-6 for |turns| < 2^22.
+  void (*sine)(const float* turns, float* out, std::size_t n);
+  // out = 1 for the second half of every period, -1 for the first.
+  void (*square)(const float* turns, float* out, std::size_t n);
+
+  // out[2i] = a[i], out[2i + 1] = b[i]
+  void (*interleave2)(const float* a, const float* b, float* out, std::size_t n);
+  // out = round(clamp(x, -1, 1) * 32767 + dither), saturated to 16 bit.
+  // dither is in LSBs and may be nullptr.
+  void (*to_int16)(const float* x, const float* dither, std::int16_t* out, std::size_t n);
+
+  // Runs all steps on kFusedChunk samples, then on the next ones, so that
+  // temporaries stay in L1 and are never written back. Rounds exactly like
+  // calling the kernel of every step on all n samples.
+  void (*run_fused)(const FusedStep* steps, std::size_t num_steps, std::size_t n);
+};
+
+// Best implementation for the running CPU, picked once on first use.
+const BlockKernels& GetBlockKernels();
+
+// Individual implementations, nullptr when not built for this target.
+const BlockKernels* GetScalarKernels();
+const BlockKernels* GetSse2Kernels();
+const BlockKernels* GetAvx2Kernels();
@@ -0,0 +1,55 @@
+// Built with -mavx2 -mfma, only reached after a runtime CPU check.
+#include "simd/kernels_impl.h"
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+#include <immintrin.h>
+
+namespace {
+
+struct Avx2Ops {
+  using V = __m256;
+  static const std::size_t kWidth = 8;
+
+  static V Load(const float* p) { return _mm256_loadu_ps(p); }
+  static void Store(float* p, V v) { _mm256_storeu_ps(p, v); }
+  static V Set1(float x) { return _mm256_set1_ps(x); }
+  static V Add(V a, V b) { return _mm256_add_ps(a, b); }
+  static V Sub(V a, V b) { return _mm256_sub_ps(a, b); }
+  static V Mul(V a, V b) { return _mm256_mul_ps(a, b); }
+  static V MulAdd(V a, V b, V c) { return _mm256_fmadd_ps(a, b, c); }
+  static V Min(V a, V b) { return _mm256_min_ps(a, b); }
+  static V Max(V a, V b) { return _mm256_max_ps(a, b); }
+  static V Neg(V a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+  static V Round(V a) { return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+  static V Less(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+  static V And(V mask_a, V mask_b) { return _mm256_and_ps(mask_a, mask_b); }
+  static V Select(V mask, V a, V b) { return _mm256_blendv_ps(b, a, mask); }
+  // Unpacking works within 128 bit lanes, the permutes put the lanes in order.
+  static void StoreInterleaved(float* p, V a, V b) {
+    V lo = _mm256_unpacklo_ps(a, b);
+    V hi = _mm256_unpackhi_ps(a, b);
+    _mm256_storeu_ps(p, _mm256_permute2f128_ps(lo, hi, 0x20));
+    _mm256_storeu_ps(p + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+  }
+  static void StoreInt16(std::int16_t* p, V a) {
+    __m256i i = _mm256_cvtps_epi32(a);
+    __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(i), _mm256_extracti128_si256(i, 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), packed);
+  }
+};
+
+}  // namespace
+
+const BlockKernels* GetAvx2Kernels() {
+  static const BlockKernels kernels = KernelsImpl<Avx2Ops>::Make("avx2");
+  return &kernels;
+}
+
+#else
+
+const BlockKernels* GetAvx2Kernels() {
+  return nullptr;
+}
+
+#endif
@@ -0,0 +1,298 @@
+#pragma once
+
+// Kernel bodies shared by every instruction set. Each kernels_*.cpp defines
+// an Ops struct with the vector primitives and instantiates KernelsImpl.
+// Only include from those files: they are built with different target flags,
+// so everything here has internal linkage to keep the linker from merging
+// e.g. an AVX2 build of ScalarOps into the fallback path.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "simd/kernels.h"
+
+namespace {
+
+// Scalar primitives, also used for the tails of the vector loops.
+struct ScalarOps {
+  using V = float;
+  static const std::size_t kWidth = 1;
+
+  static V Load(const float* p) { return *p; }
+  static void Store(float* p, V v) { *p = v; }
+  static V Set1(float x) { return x; }
+  static V Add(V a, V b) { return a + b; }
+  static V Sub(V a, V b) { return a - b; }
+  static V Mul(V a, V b) { return a * b; }
+  static V MulAdd(V a, V b, V c) { return a * b + c; }
+  static V Min(V a, V b) { return b < a ? b : a; }
+  static V Max(V a, V b) { return a < b ? b : a; }
+  static V Neg(V a) { return -a; }
+  static V Round(V a) { return std::nearbyint(a); }
+  // Mask selects: picks a where the mask is set.
+  static V Less(V a, V b) { return a < b ? 1.0f : 0.0f; }
+  static V And(V mask_a, V mask_b) { return mask_a * mask_b; }
+  static V Select(V mask, V a, V b) { return mask != 0.0f ? a : b; }
+  // Stores a[0], b[0], a[1], b[1], ...
+  static void StoreInterleaved(float* p, V a, V b) { p[0] = a; p[1] = b; }
+  // Rounds to nearest and saturates.
+  static void StoreInt16(std::int16_t* p, V a) {
+    *p = static_cast<std::int16_t>(std::clamp(std::nearbyint(a), -32768.0f, 32767.0f));
+  }
+};
+
+template <typename Ops>
+struct KernelsImpl {
+  using V = typename Ops::V;
+  static const std::size_t W = Ops::kWidth;
+
+  // Vector loop over the bulk, scalar loop over the tail.
+  template <typename VecFunc, typename ScalarFunc>
+  static void Loop(std::size_t n, VecFunc vec_func, ScalarFunc scalar_func) {
+    std::size_t i = 0;
+    for (; i + W <= n; i += W) {
+      vec_func(i);
+    }
+    for (; i < n; ++i) {
+      scalar_func(i);
+    }
+  }
+
+  // Bodies of the elementwise kernels on one vector. RunFused calls the
+  // same functions, so fused and separate ops round the same way.
+  struct Vec {
+    static V Add3(V a, V b, V c) { return Ops::Add(Ops::Add(a, b), c); }
+    static V Multiply(V a, V b) { return Ops::Mul(a, b); }
+    static V Mix(V a, V b, V t) { return Ops::MulAdd(b, t, Ops::Mul(a, Ops::Sub(Ops::Set1(1.0f), t))); }
+    static V MixScalar(V a, V b, float t) { return Ops::MulAdd(b, Ops::Set1(t), Ops::Mul(a, Ops::Set1(1.0f - t))); }
+    static V Clamp(V x, V lo, V hi) { return Ops::Min(Ops::Max(x, lo), hi); }
+    static V Negate(V x) { return Ops::Neg(x); }
+  };
+
+  // Same on one sample, for the tails.
+  struct Tail {
+    static float Add3(float a, float b, float c) { return a + b + c; }
+    static float Multiply(float a, float b) { return a * b; }
+    static float Mix(float a, float b, float t) { return a * (1.0f - t) + b * t; }
+    static float MixScalar(float a, float b, float t) { return a * (1.0f - t) + b * t; }
+    static float Clamp(float x, float lo, float hi) { return ScalarOps::Min(ScalarOps::Max(x, lo), hi); }
+    static float Negate(float x) { return -x; }
+  };
+
+  static void Add3(const float* a, const float* b, const float* c, float* out, std::size_t n) {
+    Loop(n,
+      [&] (std::size_t i) { Ops::Store(out + i, Vec::Add3(Ops::Load(a + i), Ops::Load(b + i), Ops::Load(c + i))); },
+      [&] (std::size_t i) { out[i] = Tail::Add3(a[i], b[i], c[i]); });
+  }
+
+  static void Multiply(const float* a, const float* b, float* out, std::size_t n) {
+    Loop(n,
+      [&] (std::size_t i) { Ops::Store(out + i, Vec::Multiply(Ops::Load(a + i), Ops::Load(b + i))); },
+      [&] (std::size_t i) { out[i] = Tail::Multiply(a[i], b[i]); });
+  }
+
+  static void Scale(const float* a, float k, float* out, std::size_t n) {
+    V vk = Ops::Set1(k);
+    Loop(n,
+      [&] (std::size_t i) { Ops::Store(out + i, Ops::Mul(Ops::Load(a + i), vk)); },
+      [&] (std::size_t i) { out[i] = a[i] * k; });
+  }
+
+  static void Mix(const float* a, const float* b, const float* alpha, float* out, std::size_t n) {
+    Loop(n,
+      [&] (std::size_t i) { Ops::Store(out + i, Vec::Mix(Ops::Load(a + i), Ops::Load(b + i), Ops::Load(alpha + i))); },
+      [&] (std::size_t i) { out[i] = Tail::Mix(a[i], b[i], alpha[i]); });
+  }
+
+  static void MixScalar(const float* a, const float* b, float alpha, float* out, std::size_t n) {
+    Loop(n,
+      [&] (std::size_t i) { Ops::Store(out + i, Vec::MixScalar(Ops::Load(a + i), Ops::Load(b + i), alpha)); },
+      [&] (std::size_t i) { out[i] = Tail::MixScalar(a[i], b[i], alpha); });
+  }
+
+  static void Clamp(const float* x, const float* lo, const float* hi, float* out, std::size_t n) {
+    Loop(n,
+      [&] (std::size_t i) { Ops::Store(out + i, Vec::Clamp(Ops::Load(x + i), Ops::Load(lo + i), Ops::Load(hi + i))); },
+      [&] (std::size_t i) { out[i] = Tail::Clamp(x[i], lo[i], hi[i]); });
+  }
+
+  static void Negate(const float* x, float* out, std::size_t n) {
+    Loop(n,
+      [&] (std::size_t i) { Ops::Store(out + i, Vec::Negate(Ops::Load(x + i))); },
+      [&] (std::size_t i) { out[i] = Tail::Negate(x[i]); });
+  }
+
+  // sin(2 * pi * x). Reduces to r in [-1/4, 1/4] turns using periodicity and
+  // sin(pi - y) = sin(y), then evaluates the Taylor series up to y^11.
+  // Truncation error on [-pi/2, pi/2] is below 6e-8.
+  template <typename O>
+  static typename O::V SineTurns(typename O::V x) {
+    using T = typename O::V;
+    T r = O::Sub(x, O::Round(x));  // [-0.5, 0.5]
+    T quarter = O::Set1(0.25f);
+    T half = O::Set1(0.5f);
+    r = O::Select(O::Less(quarter, r), O::Sub(half, r), r);
+    r = O::Select(O::Less(r, O::Neg(quarter)), O::Sub(O::Neg(half), r), r);
+
+    T y = O::Mul(r, O::Set1(6.28318530717958647692f));
+    T y2 = O::Mul(y, y);
+    T p = O::Set1(-2.50521083854417187751e-8f);             // -1/11!
+    p = O::MulAdd(p, y2, O::Set1(2.75573192239858906526e-6f));  // 1/9!
+    p = O::MulAdd(p, y2, O::Set1(-1.98412698412698412698e-4f)); // -1/7!
+    p = O::MulAdd(p, y2, O::Set1(8.33333333333333333333e-3f));  // 1/5!
+    p = O::MulAdd(p, y2, O::Set1(-1.66666666666666666667e-1f)); // -1/3!
+    return O::MulAdd(O::Mul(p, y2), y, y);
+  }
+
+  static void Sine(const float* turns, float* out, std::size_t n) {
+    Loop(n,
+      [&] (std::size_t i) { Ops::Store(out + i, SineTurns<Ops>(Ops::Load(turns + i))); },
+      [&] (std::size_t i) { out[i] = SineTurns<ScalarOps>(turns[i]); });
+  }
+
+  // Second half of the period is where x - round(x) lies in (-0.5, 0).
+  template <typename O>
+  static typename O::V SquareTurns(typename O::V x) {
+    using T = typename O::V;
+    T r = O::Sub(x, O::Round(x));
+    T high = O::And(O::Less(r, O::Set1(0.0f)), O::Less(O::Set1(-0.5f), r));
+    return O::Select(high, O::Set1(1.0f), O::Set1(-1.0f));
+  }
+
+  static void Square(const float* turns, float* out, std::size_t n) {
+    Loop(n,
+      [&] (std::size_t i) { Ops::Store(out + i, SquareTurns<Ops>(Ops::Load(turns + i))); },
+      [&] (std::size_t i) { out[i] = SquareTurns<ScalarOps>(turns[i]); });
+  }
+
+  static void Interleave2(const float* a, const float* b, float* out, std::size_t n) {
+    Loop(n,
+      [&] (std::size_t i) { Ops::StoreInterleaved(out + 2 * i, Ops::Load(a + i), Ops::Load(b + i)); },
+      [&] (std::size_t i) { ScalarOps::StoreInterleaved(out + 2 * i, a[i], b[i]); });
+  }
+
+  static void ToInt16(const float* x, const float* dither, std::int16_t* out, std::size_t n) {
+    V lo = Ops::Set1(-1.0f);
+    V hi = Ops::Set1(1.0f);
+    V full_scale = Ops::Set1(32767.0f);
+    auto scaled = [&] (std::size_t i) {
+      return Ops::Mul(Ops::Min(Ops::Max(Ops::Load(x + i), lo), hi), full_scale);
+    };
+    auto scaled_scalar = [&] (std::size_t i) {
+      return std::clamp(x[i], -1.0f, 1.0f) * 32767.0f;
+    };
+
+    if (dither) {
+      Loop(n,
+        [&] (std::size_t i) { Ops::StoreInt16(out + i, Ops::Add(scaled(i), Ops::Load(dither + i))); },
+        [&] (std::size_t i) { ScalarOps::StoreInt16(out + i, scaled_scalar(i) + dither[i]); });
+    } else {
+      Loop(n,
+        [&] (std::size_t i) { Ops::StoreInt16(out + i, scaled(i)); },
+        [&] (std::size_t i) { ScalarOps::StoreInt16(out + i, scaled_scalar(i)); });
+    }
+  }
+
+  // Body of an op of kind kKind from F, one of Vec and Tail, as a function
+  // of three operands.
+  template <typename F, ElementwiseOp::Kind kKind>
+  static auto Body(const ElementwiseOp& op) {
+    if constexpr (kKind == ElementwiseOp::kAdd3) {
+      return [] (auto a, auto b, auto c) { return F::Add3(a, b, c); };
+    } else if constexpr (kKind == ElementwiseOp::kMultiply) {
+      return [] (auto a, auto b, auto) { return F::Multiply(a, b); };
+    } else if constexpr (kKind == ElementwiseOp::kMix) {
+      return [] (auto a, auto b, auto c) { return F::Mix(a, b, c); };
+    } else if constexpr (kKind == ElementwiseOp::kMixScalar) {
+      return [t = *op.param] (auto a, auto b, auto) { return F::MixScalar(a, b, t); };
+    } else if constexpr (kKind == ElementwiseOp::kClamp) {
+      return [] (auto a, auto b, auto c) { return F::Clamp(a, b, c); };
+    } else {
+      static_assert(kKind == ElementwiseOp::kNegate);
+      return [] (auto a, auto, auto) { return F::Negate(a); };
+    }
+  }
+
+  // One step on samples [i, i + size). kSize is size when known at compile
+  // time, so that full passes unroll, 0 otherwise.
+  template <typename F, std::size_t kSize, ElementwiseOp::Kind kKind>
+  static void FusedPass(const FusedStep& step, std::size_t i, std::size_t size) {
+    if constexpr (kSize != 0) {
+      size = kSize;
+    }
+    const std::size_t num_inputs = ElementwiseOp::NumInputs(kKind);
+    const float* a = step.in[0] + i * step.in_stride[0];
+    const float* b = num_inputs > 1 ? step.in[1] + i * step.in_stride[1] : a;  // Ignored by body otherwise
+    const float* c = num_inputs > 2 ? step.in[2] + i * step.in_stride[2] : a;
+    float* out = step.out + i * step.out_stride;
+    auto body = Body<F, kKind>(step.op);
+    if constexpr (std::is_same_v<F, Vec>) {
+      for (std::size_t j = 0; j + W <= size; j += W) {
+        Ops::Store(out + j, body(Ops::Load(a + j), Ops::Load(b + j), Ops::Load(c + j)));
+      }
+    } else {
+      for (std::size_t j = 0; j < size; ++j) {
+        out[j] = body(a[j], b[j], c[j]);
+      }
+    }
+  }
+
+  using FusedPassFn = void (*)(const FusedStep& step, std::size_t i, std::size_t size);
+
+  // FusedPass of every kind, indexed by ElementwiseOp::Kind.
+  template <typename F, std::size_t kSize>
+  static constexpr FusedPassFn kFusedPasses[] = {
+    &FusedPass<F, kSize, ElementwiseOp::kAdd3>,
+    &FusedPass<F, kSize, ElementwiseOp::kMultiply>,
+    &FusedPass<F, kSize, ElementwiseOp::kMix>,
+    &FusedPass<F, kSize, ElementwiseOp::kMixScalar>,
+    &FusedPass<F, kSize, ElementwiseOp::kClamp>,
+    &FusedPass<F, kSize, ElementwiseOp::kNegate>,
+  };
+
+  template <typename F, std::size_t kSize>
+  static void RunPasses(const FusedStep* steps, std::size_t num_steps, std::size_t i, std::size_t size) {
+    for (std::size_t s = 0; s < num_steps; ++s) {
+      kFusedPasses<F, kSize>[steps[s].op.kind](steps[s], i, size);
+    }
+  }
+
+  // Vectors and tail split as in Loop, so every sample takes the same path
+  // as in the separate kernels.
+  static void RunFused(const FusedStep* steps, std::size_t num_steps, std::size_t n) {
+    std::size_t vector_end = n / W * W;
+    std::size_t i = 0;
+    for (; i + kFusedChunk <= vector_end; i += kFusedChunk) {
+      RunPasses<Vec, kFusedChunk>(steps, num_steps, i, kFusedChunk);
+    }
+    if (i < vector_end) {
+      RunPasses<Vec, 0>(steps, num_steps, i, vector_end - i);
+    }
+    if (vector_end < n) {
+      RunPasses<Tail, 0>(steps, num_steps, vector_end, n - vector_end);
+    }
+  }
+
+  static BlockKernels Make(const char* name) {
+    return BlockKernels{
+      .name = name,
+      .add3 = &Add3,
+      .multiply = &Multiply,
+      .scale = &Scale,
+      .mix = &Mix,
+      .mix_scalar = &MixScalar,
+      .clamp = &Clamp,
+      .negate = &Negate,
+      .sine = &Sine,
+      .square = &Square,
+      .interleave2 = &Interleave2,
+      .to_int16 = &ToInt16,
+      .run_fused = &RunFused,
+    };
+  }
+};
+
+}  // namespace
@@ -0,0 +1,6 @@
+#include "simd/kernels_impl.h"
+
+const BlockKernels* GetScalarKernels() {
+  static const BlockKernels kernels = KernelsImpl<ScalarOps>::Make("scalar");
+  return &kernels;
+}
@@ -0,0 +1,52 @@
+#include "simd/kernels_impl.h"
+
+#if defined(__SSE2__)
+
+#include <emmintrin.h>
+
+namespace {
+
+struct Sse2Ops {
+  using V = __m128;
+  static const std::size_t kWidth = 4;
+
+  static V Load(const float* p) { return _mm_loadu_ps(p); }
+  static void Store(float* p, V v) { _mm_storeu_ps(p, v); }
+  static V Set1(float x) { return _mm_set1_ps(x); }
+  static V Add(V a, V b) { return _mm_add_ps(a, b); }
+  static V Sub(V a, V b) { return _mm_sub_ps(a, b); }
+  static V Mul(V a, V b) { return _mm_mul_ps(a, b); }
+  static V MulAdd(V a, V b, V c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+  static V Min(V a, V b) { return _mm_min_ps(a, b); }
+  static V Max(V a, V b) { return _mm_max_ps(a, b); }
+  static V Neg(V a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+  // Conversion rounds to nearest even, valid for |a| < 2^31.
+  static V Round(V a) { return _mm_cvtepi32_ps(_mm_cvtps_epi32(a)); }
+  static V Less(V a, V b) { return _mm_cmplt_ps(a, b); }
+  static V And(V mask_a, V mask_b) { return _mm_and_ps(mask_a, mask_b); }
+  static V Select(V mask, V a, V b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+  static void StoreInterleaved(float* p, V a, V b) {
+    _mm_storeu_ps(p, _mm_unpacklo_ps(a, b));
+    _mm_storeu_ps(p + 4, _mm_unpackhi_ps(a, b));
+  }
+  // Packing saturates.
+  static void StoreInt16(std::int16_t* p, V a) {
+    __m128i i = _mm_cvtps_epi32(a);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packs_epi32(i, i));
+  }
+};
+
+}  // namespace
+
+const BlockKernels* GetSse2Kernels() {
+  static const BlockKernels kernels = KernelsImpl<Sse2Ops>::Make("sse2");
+  return &kernels;
+}
+
+#else
+
+const BlockKernels* GetSse2Kernels() {
+  return nullptr;
+}
+
+#endif
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <compare>
+#include <cstdint>
+#include <vector>
+
+#include "util.h"
+
+// Reference to an element of a SlotMap. The generation tells apart the
+// elements that used the same slot, so a handle to a removed element
+// never finds the one that replaced it. Tag keeps handles of different
+// maps apart at compile time and, through Tag::kKind, in Pack() too.
+template <typename Tag>
+struct Handle {
+  std::uint32_t index = 0;
+  std::uint32_t generation = 0;  // 0 only for the null handle
+
+  bool IsValid() const {
+    return generation != 0;
+  }
+
+  // One 64 bit value with the kind in the top byte: handles of different
+  // kinds never pack to the same value, and valid ones never to 0.
+  std::uint64_t Pack() const {
+    return (std::uint64_t{Tag::kKind} << 56) | (std::uint64_t{generation} << 32) | index;
+  }
+
+  // Anything that isn't a Pack() of this kind unpacks to a null handle.
+  static Handle Unpack(std::uint64_t value) {
+    if ((value >> 56) != Tag::kKind) {
+      return {};
+    }
+    return {static_cast<std::uint32_t>(value), static_cast<std::uint32_t>(value >> 32) & kGenerationMask};
+  }
+
+  auto operator<=>(const Handle&) const = default;
+
+  // Generations wrap within 24 bits to leave room for the kind.
+  static constexpr std::uint32_t kGenerationMask = 0xFFFFFF;
+};
+
+// Values stored contiguously, looked up by handle in O(1). Slots are
+// reused, their generation moves on every time. Removal moves the last
+// value into the hole, so iteration order is not insertion order and
+// pointers into the map are invalidated by any insert or removal.
+template <typename T, typename Tag>
+class SlotMap {
+ public:
+  using Id = Handle<Tag>;
+
+  struct Entry {
+    Id id;
+    T value;
+  };
+
+  Id Insert(T value) {
+    std::uint32_t index = 0;
+    if (free_slots.empty()) {
+      index = static_cast<std::uint32_t>(slots.size());
+      slots.emplace_back();
+    } else {
+      index = free_slots.back();
+      free_slots.pop_back();
+    }
+
+    auto& slot = slots[index];
+    slot.generation = (slot.generation + 1) & Id::kGenerationMask;
+    if (slot.generation == 0) {
+      slot.generation = 1;
+    }
+    slot.dense = static_cast<std::uint32_t>(entries.size());
+
+    Id id{index, slot.generation};
+    entries.push_back(Entry{id, std::move(value)});
+    return id;
+  }
+
+  // False if id is stale.
+  bool Erase(Id id) {
+    if (!Contains(id)) {
+      return false;
+    }
+
+    auto& slot = slots[id.index];
+    if (slot.dense != entries.size() - 1) {
+      entries[slot.dense] = std::move(entries.back());
+      slots[entries[slot.dense].id.index].dense = slot.dense;
+    }
+    entries.pop_back();
+    slot.dense = kNoEntry;
+    free_slots.push_back(id.index);
+    return true;
+  }
+
+  bool Contains(Id id) const {
+    return id.index < slots.size() && slots[id.index].generation == id.generation &&
+           slots[id.index].dense != kNoEntry;
+  }
+
+  T* Find(Id id) {
+    return Contains(id) ? &entries[slots[id.index].dense].value : nullptr;
+  }
+
+  const T* Find(Id id) const {
+    return Contains(id) ? &entries[slots[id.index].dense].value : nullptr;
+  }
+
+  // id has to be live.
+  T& Get(Id id) {
+    T* value = Find(id);
+    if (!value) {
+      Assert(false, "SlotMap: stale handle");
+    }
+    return *value;
+  }
+
+  const T& Get(Id id) const {
+    const T* value = Find(id);
+    if (!value) {
+      Assert(false, "SlotMap: stale handle");
+    }
+    return *value;
+  }
+
+  // Handle of whatever lives in slot index now, null if nothing does.
+  Id IdAt(std::uint32_t index) const {
+    if (index >= slots.size() || slots[index].dense == kNoEntry) {
+      return {};
+    }
+    return {index, slots[index].generation};
+  }
+
+  // Slot indices are below this.
+  std::size_t NumSlots() const {
+    return slots.size();
+  }
+
+  std::size_t size() const {
+    return entries.size();
+  }
+
+  bool empty() const {
+    return entries.empty();
+  }
+
+  // Bytes held by the map itself, not by what its values point to.
+  std::size_t MemoryUsage() const {
+    return entries.capacity() * sizeof(Entry) + slots.capacity() * sizeof(Slot) +
+           free_slots.capacity() * sizeof(std::uint32_t);
+  }
+
+  void reserve(std::size_t n) {
+    entries.reserve(n);
+    slots.reserve(n);
+  }
+
+  auto begin() { return entries.begin(); }
+  auto end() { return entries.end(); }
+  auto begin() const { return entries.begin(); }
+  auto end() const { return entries.end(); }
+
+ private:
+  static constexpr std::uint32_t kNoEntry = UINT32_MAX;
+
+  struct Slot {
+    std::uint32_t generation = 0;
+    std::uint32_t dense = kNoEntry;  // Index in entries
+  };
+
+  std::vector<Entry> entries;
+  std::vector<Slot> slots;
+  std::vector<std::uint32_t> free_slots;
+};
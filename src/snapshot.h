@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "util.h"
+
+
+// Read-copy-update cell with a single reader (the audio thread).
+// The writer publishes immutable snapshots with an atomic pointer swap.
+// Replaced snapshots are retired and freed on the writer thread
+// once the reader can no longer hold them. The reader never blocks.
+//
+// A retired snapshot may also wait for a fence: a counter the reader
+// advances on its own, e.g. the number of processed queue messages that
+// can still point into the snapshot.
+template <typename T>
+class SnapshotCell {
+ public:
+  // Reader side guard. Keeps the snapshot alive while in scope.
+  class ReadGuard {
+   public:
+    explicit ReadGuard(SnapshotCell* cell) : cell(cell), ptr(cell->Enter()) { }
+    ~ReadGuard() { cell->Leave(); }
+
+    ReadGuard(const ReadGuard&) = delete;
+    ReadGuard& operator= (const ReadGuard&) = delete;
+
+    T* operator-> () const { return ptr; }
+    T* get() const { return ptr; }
+
+   private:
+    SnapshotCell* cell;
+    T* ptr;
+  };
+
+  // Writer thread only.
+  void Publish(std::unique_ptr<T> snapshot, std::uint64_t fence = 0) {
+    current.store(snapshot.get());
+    // Reader epoch is odd while it is inside a read section.
+    retired.push_back({std::move(owner), reader_epoch.load(), fence});
+    owner = std::move(snapshot);
+  }
+
+  // Writer thread only. Frees retired snapshots the reader is done with
+  // and whose fence is at or below fence_reached.
+  void Collect(std::uint64_t fence_reached = 0) {
+    std::uint64_t epoch = reader_epoch.load();
+    std::erase_if(retired, [epoch, fence_reached] (const Retired& r) {
+      bool was_reading = r.epoch % 2 == 1;
+      bool released = !was_reading || epoch != r.epoch;
+      return released && r.fence <= fence_reached;
+    });
+  }
+
+  // Writer thread only.
+  T* GetLatest() const {
+    return owner.get();
+  }
+
+  std::size_t NumRetired() const {
+    return retired.size();
+  }
+
+  // Reader thread only.
+  ReadGuard Acquire() {
+    return ReadGuard(this);
+  }
+
+ private:
+  struct Retired {
+    std::unique_ptr<T> snapshot;
+    std::uint64_t epoch;
+    std::uint64_t fence;
+  };
+
+  // Epoch is bumped before the pointer is loaded. Together with seq_cst
+  // on both sides this guarantees that a writer seeing an even epoch
+  // after the swap can't race with a reader holding the old pointer.
+  T* Enter() {
+    reader_epoch.fetch_add(1);
+    return current.load();
+  }
+
+  void Leave() {
+    reader_epoch.fetch_add(1, std::memory_order_release);
+  }
+
+  alignas(64) std::atomic<T*> current = nullptr;
+  alignas(64) std::atomic<std::uint64_t> reader_epoch = 0;
+
+  // Writer-owned state
+  alignas(64) std::unique_ptr<T> owner;
+  std::vector<Retired> retired;
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "util.h"
+
+
+// Wait-free single producer, single consumer queue of fixed capacity.
+// Capacity is rounded up to a power of two. Head and tail only grow,
+// so they double as total push and pop counters.
+template <typename T>
+class SpscQueue {
+ public:
+  explicit SpscQueue(std::size_t capacity) {
+    std::size_t size = 1;
+    while (size < capacity) {
+      size *= 2;
+    }
+    mask = size - 1;
+    items.resize(size);
+  }
+
+  // Producer only. Returns false if the queue is full.
+  bool TryPush(const T& item) {
+    std::uint64_t tail_pos = tail.load(std::memory_order_relaxed);
+    if (tail_pos - head.load(std::memory_order_acquire) > mask) {
+      return false;
+    }
+
+    items[tail_pos & mask] = item;
+    tail.store(tail_pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only. Oldest item or nullptr if the queue is empty.
+  const T* Front() const {
+    std::uint64_t head_pos = head.load(std::memory_order_relaxed);
+    if (head_pos == tail.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    return &items[head_pos & mask];
+  }
+
+  // Consumer only. Must follow a successful Front().
+  void Pop() {
+    head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  std::uint64_t NumPushed() const {
+    return tail.load(std::memory_order_acquire);
+  }
+
+  std::uint64_t NumPopped() const {
+    return head.load(std::memory_order_acquire);
+  }
+
+  std::size_t Capacity() const {
+    return mask + 1;
+  }
+
+ private:
+  std::vector<T> items;
+  std::uint64_t mask;
+
+  alignas(64) std::atomic<std::uint64_t> head = 0;
+  alignas(64) std::atomic<std::uint64_t> tail = 0;
+};
@@ -0,0 +1,98 @@
+#include "telemetry.h"
+
+#include <algorithm>
+
+#include "output.h"
+
+namespace {
+
+// Bins 0-9 cover [0, 1) in steps of 0.1, bin 10 [1, 2), bin 11 the rest.
+std::size_t BinOf(double load) {
+  if (load >= 2) {
+    return TelemetrySnapshot::kNumBins - 1;
+  }
+  if (load >= 1) {
+    return TelemetrySnapshot::kNumBins - 2;
+  }
+  return static_cast<std::size_t>(std::max(load, 0.0) * 10);
+}
+
+}  // namespace
+
+TelemetrySnapshot TelemetrySnapshot::operator-(const TelemetrySnapshot& base) const {
+  TelemetrySnapshot delta = *this;
+  delta.periods -= base.periods;
+  delta.frames -= base.frames;
+  delta.underruns -= base.underruns;
+  delta.missing_frames -= base.missing_frames;
+  delta.device_xruns -= base.device_xruns;
+  for (std::size_t i = 0; i < kNumBins; ++i) {
+    delta.deadline_histogram[i] -= base.deadline_histogram[i];
+  }
+  return delta;
+}
+
+double TelemetrySnapshot::BinStart(std::size_t bin) {
+  if (bin >= kNumBins - 1) {
+    return 2;
+  }
+  if (bin == kNumBins - 2) {
+    return 1;
+  }
+  return bin * 0.1;
+}
+
+Telemetry::Telemetry()
+    // Calibrates the counter on first use, which blocks: done here, off
+    // the audio thread.
+    : cycles_per_frame(CyclesPerSecond() / kSampleRate) {
+}
+
+void Telemetry::RecordPeriod(std::size_t n, std::size_t valid, std::size_t fill) {
+  std::uint64_t period = periods.load(std::memory_order_relaxed);
+  std::uint64_t start = frames.load(std::memory_order_relaxed);
+  fill_history[period % kFillHistorySize].store(static_cast<std::uint32_t>(fill), std::memory_order_relaxed);
+
+  if (valid < n) {
+    underruns.fetch_add(1, std::memory_order_relaxed);
+    missing_frames.fetch_add(n - valid, std::memory_order_relaxed);
+    last_underrun.store(start + valid, std::memory_order_relaxed);
+  }
+  frames.store(start + n, std::memory_order_relaxed);
+  periods.store(period + 1, std::memory_order_relaxed);
+}
+
+void Telemetry::RecordRender(std::size_t n, std::uint64_t cycles) {
+  if (n == 0) {
+    return;
+  }
+  double load = cycles / (cycles_per_frame * n);
+  deadline_histogram[BinOf(load)].fetch_add(1, std::memory_order_relaxed);
+  if (load > worst_load.load(std::memory_order_relaxed)) {
+    worst_load.store(load, std::memory_order_relaxed);
+  }
+}
+
+TelemetrySnapshot Telemetry::GetSnapshot() const {
+  TelemetrySnapshot snapshot;
+  snapshot.periods = periods.load(std::memory_order_relaxed);
+  snapshot.frames = frames.load(std::memory_order_relaxed);
+  snapshot.underruns = underruns.load(std::memory_order_relaxed);
+  snapshot.missing_frames = missing_frames.load(std::memory_order_relaxed);
+  snapshot.device_xruns = device_xruns.load(std::memory_order_relaxed);
+  snapshot.last_underrun = last_underrun.load(std::memory_order_relaxed);
+  for (std::size_t i = 0; i < TelemetrySnapshot::kNumBins; ++i) {
+    snapshot.deadline_histogram[i] = deadline_histogram[i].load(std::memory_order_relaxed);
+  }
+  snapshot.worst_load = worst_load.load(std::memory_order_relaxed);
+  return snapshot;
+}
+
+std::array<float, Telemetry::kFillHistorySize> Telemetry::GetFillHistory() const {
+  std::array<float, kFillHistorySize> history;
+  std::uint64_t next = periods.load(std::memory_order_relaxed);
+  for (std::size_t i = 0; i < kFillHistorySize; ++i) {
+    history[i] = static_cast<float>(fill_history[(next + i) % kFillHistorySize].load(std::memory_order_relaxed));
+  }
+  return history;
+}
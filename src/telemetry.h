@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include "profiler.h"
+
+// A copy of the telemetry counters at one point in time. Subtract two to
+// get what happened in between.
+struct TelemetrySnapshot {
+  static constexpr std::size_t kNumBins = 12;
+
+  std::uint64_t periods = 0;         // Backend callbacks or wakeups
+  std::uint64_t frames = 0;          // Frames handed to the device
+  std::uint64_t underruns = 0;       // Periods the engine couldn't fill
+  std::uint64_t missing_frames = 0;  // Silence inserted for them
+  std::uint64_t device_xruns = 0;    // Reported by the device itself
+  std::uint64_t last_underrun = 0;   // Frame at which the last one started
+
+  // Renders by render time over the time the rendered audio lasts: ten
+  // bins of 10%, then up to 2x and beyond. The last two missed the deadline.
+  std::array<std::uint64_t, kNumBins> deadline_histogram{};
+  double worst_load = 0;  // Since start, not affected by subtraction
+
+  TelemetrySnapshot operator-(const TelemetrySnapshot& base) const;
+
+  // Lower bound of a histogram bin, as a fraction of the deadline.
+  static double BinStart(std::size_t bin);
+};
+
+// Health of the audio path, written from the backend callback and the
+// render thread, read from anywhere. Everything is a relaxed atomic: a
+// reader may see a callback half recorded, never a torn value.
+class Telemetry {
+ public:
+  static constexpr std::size_t kFillHistorySize = 256;
+
+  Telemetry();
+
+  // Backend, once per period: n frames asked for, valid of them available.
+  // fill is the ring level in frames before the read, 0 in pull mode.
+  void RecordPeriod(std::size_t n, std::size_t valid, std::size_t fill);
+
+  // Backend, when the device reports it dropped or repeated a buffer.
+  void RecordDeviceXrun() {
+    device_xruns.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Render thread: rendering n frames took cycles, as from ReadCycles().
+  void RecordRender(std::size_t n, std::uint64_t cycles);
+
+  TelemetrySnapshot GetSnapshot() const;
+
+  // Ring levels at the last kFillHistorySize periods, oldest first.
+  std::array<float, kFillHistorySize> GetFillHistory() const;
+
+ private:
+  const double cycles_per_frame;
+
+  std::atomic<std::uint64_t> periods = 0;
+  std::atomic<std::uint64_t> frames = 0;
+  std::atomic<std::uint64_t> underruns = 0;
+  std::atomic<std::uint64_t> missing_frames = 0;
+  std::atomic<std::uint64_t> device_xruns = 0;
+  std::atomic<std::uint64_t> last_underrun = 0;
+  std::array<std::atomic<std::uint64_t>, TelemetrySnapshot::kNumBins> deadline_histogram{};
+  std::atomic<double> worst_load = 0;
+
+  std::array<std::atomic<std::uint32_t>, kFillHistorySize> fill_history{};
+};
@@ -0,0 +1,178 @@
+#include "topological_order.h"
+
+#include <algorithm>
+
+#include "util.h"
+
+namespace {
+
+void EraseOne(std::vector<TopologicalOrder::Vertex>& edges, TopologicalOrder::Vertex v) {
+  auto it = std::find(edges.begin(), edges.end(), v);
+  ASSERT(it != edges.end());
+  edges.erase(it);
+}
+
+}  // namespace
+
+void TopologicalOrder::AddVertex(Vertex v) {
+  ASSERT(v != kNoVertex);
+  VertexInfo info;
+  info.position = order.size();
+  MapInsert(vertices, v, info);
+  order.push_back(v);
+}
+
+void TopologicalOrder::RemoveVertex(Vertex v) {
+  auto& info = MapGetRef(vertices, v);
+  for (Vertex w : info.out) {
+    EraseOne(MapGetRef(vertices, w).in, v);
+  }
+
+  for (Vertex w : info.in) {
+    EraseOne(MapGetRef(vertices, w).out, v);
+  }
+
+  order[info.position] = kNoVertex;
+  ++num_holes;
+  MapErase(vertices, v);
+  Compact();
+}
+
+bool TopologicalOrder::WouldCreateCycle(Vertex from, Vertex to) const {
+  if (from == to) {
+    return true;
+  }
+
+  std::size_t lower = MapGetConstRef(vertices, to).position;
+  std::size_t upper = MapGetConstRef(vertices, from).position;
+  if (lower > upper) {
+    return false;
+  }
+
+  std::vector<Vertex> found;
+  return !SearchForward(to, upper, &found);
+}
+
+bool TopologicalOrder::AddEdge(Vertex from, Vertex to) {
+  last_affected = 0;
+  if (from == to) {
+    return false;
+  }
+
+  auto& from_info = MapGetRef(vertices, from);
+  auto& to_info = MapGetRef(vertices, to);
+  std::size_t lower = to_info.position;
+  std::size_t upper = from_info.position;
+
+  if (lower < upper) {
+    forward.clear();
+    if (!SearchForward(to, upper, &forward)) {
+      return false;
+    }
+
+    backward.clear();
+    SearchBackward(from, lower, &backward);
+    last_affected = forward.size() + backward.size();
+    Reorder(backward, forward);
+  }
+  DEBUG_ASSERT(from_info.position < to_info.position);
+
+  from_info.out.push_back(to);
+  to_info.in.push_back(from);
+  return true;
+}
+
+void TopologicalOrder::RemoveEdge(Vertex from, Vertex to) {
+  EraseOne(MapGetRef(vertices, from).out, to);
+  EraseOne(MapGetRef(vertices, to).in, from);
+}
+
+bool TopologicalOrder::SearchForward(Vertex start, std::size_t upper, std::vector<Vertex>* found) const {
+  ++epoch;
+  stack.clear();
+  stack.push_back(start);
+  vertices.find(start)->second.visited = epoch;
+
+  while (!stack.empty()) {
+    Vertex v = stack.back();
+    stack.pop_back();
+    found->push_back(v);
+
+    for (Vertex w : vertices.find(v)->second.out) {
+      const auto& info = vertices.find(w)->second;
+      if (info.position == upper) {
+        return false;
+      }
+
+      if (info.visited != epoch && info.position < upper) {
+        info.visited = epoch;
+        stack.push_back(w);
+      }
+    }
+  }
+  return true;
+}
+
+void TopologicalOrder::SearchBackward(Vertex start, std::size_t lower, std::vector<Vertex>* found) const {
+  ++epoch;
+  stack.clear();
+  stack.push_back(start);
+  vertices.find(start)->second.visited = epoch;
+
+  while (!stack.empty()) {
+    Vertex v = stack.back();
+    stack.pop_back();
+    found->push_back(v);
+
+    for (Vertex w : vertices.find(v)->second.in) {
+      const auto& info = vertices.find(w)->second;
+      if (info.visited != epoch && info.position > lower) {
+        info.visited = epoch;
+        stack.push_back(w);
+      }
+    }
+  }
+}
+
+void TopologicalOrder::Reorder(std::vector<Vertex>& backward_set, std::vector<Vertex>& forward_set) {
+  auto by_position = [this] (Vertex a, Vertex b) {
+    return vertices.find(a)->second.position < vertices.find(b)->second.position;
+  };
+  std::sort(backward_set.begin(), backward_set.end(), by_position);
+  std::sort(forward_set.begin(), forward_set.end(), by_position);
+
+  positions.clear();
+  for (Vertex v : backward_set) {
+    positions.push_back(vertices.find(v)->second.position);
+  }
+  for (Vertex v : forward_set) {
+    positions.push_back(vertices.find(v)->second.position);
+  }
+  std::sort(positions.begin(), positions.end());
+
+  std::size_t idx = 0;
+  for (Vertex v : backward_set) {
+    vertices.find(v)->second.position = positions[idx];
+    order[positions[idx++]] = v;
+  }
+  for (Vertex v : forward_set) {
+    vertices.find(v)->second.position = positions[idx];
+    order[positions[idx++]] = v;
+  }
+}
+
+void TopologicalOrder::Compact() {
+  if (num_holes < 64 || num_holes * 2 < order.size()) {
+    return;
+  }
+
+  std::size_t next = 0;
+  for (Vertex v : order) {
+    if (v != kNoVertex) {
+      vertices.find(v)->second.position = next;
+      order[next++] = v;
+    }
+  }
+  order.resize(next);
+  num_holes = 0;
+}
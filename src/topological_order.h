@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+// Topological order of a DAG kept up to date under edits, after Pearce and
+// Kelly, "A Dynamic Topological Sort Algorithm for Directed Acyclic Graphs".
+//
+// Every vertex holds a position. An edge that agrees with the positions is
+// added in O(1). Otherwise only the vertices positioned between its two ends
+// and reachable from them are visited, and their positions shuffled among
+// themselves. The same search detects cycles. Removing edges or vertices
+// never invalidates the order.
+//
+// Parallel edges are allowed, each one has to be removed separately.
+class TopologicalOrder {
+ public:
+  using Vertex = int;
+
+  void AddVertex(Vertex v);
+
+  // Also removes the edges of v.
+  void RemoveVertex(Vertex v);
+
+  // Returns false and leaves the graph unchanged if the edge closes a cycle.
+  bool AddEdge(Vertex from, Vertex to);
+
+  bool WouldCreateCycle(Vertex from, Vertex to) const;
+
+  void RemoveEdge(Vertex from, Vertex to);
+
+  std::size_t Size() const {
+    return vertices.size();
+  }
+
+  // Calls f(v) for every vertex, sources first.
+  template <typename F>
+  void ForEach(F f) const {
+    for (Vertex v : order) {
+      if (v != kNoVertex) {
+        f(v);
+      }
+    }
+  }
+
+  // Vertices visited by the last AddEdge, for benchmarks.
+  std::size_t LastAffected() const {
+    return last_affected;
+  }
+
+ private:
+  static const Vertex kNoVertex = std::numeric_limits<Vertex>::min();
+
+  struct VertexInfo {
+    std::size_t position = 0;
+    std::vector<Vertex> out;
+    std::vector<Vertex> in;
+    mutable std::uint64_t visited = 0;  // Search epoch it was last seen in
+  };
+
+  // Collects vertices reachable from start positioned below upper.
+  // Returns false as soon as it reaches the vertex at upper.
+  bool SearchForward(Vertex start, std::size_t upper, std::vector<Vertex>* found) const;
+
+  // Collects vertices reaching start positioned above lower.
+  void SearchBackward(Vertex start, std::size_t lower, std::vector<Vertex>* found) const;
+
+  // Reassigns the positions held by both sets: backward set first.
+  void Reorder(std::vector<Vertex>& backward, std::vector<Vertex>& forward);
+
+  // Drops the holes left by removed vertices once they dominate.
+  void Compact();
+
+  std::unordered_map<Vertex, VertexInfo> vertices;
+  std::vector<Vertex> order;  // Position to vertex, kNoVertex for holes
+  std::size_t num_holes = 0;
+
+  // Search scratch space, kept to avoid allocations on every edit.
+  mutable std::uint64_t epoch = 0;
+  mutable std::vector<Vertex> stack;
+  std::vector<Vertex> forward;
+  std::vector<Vertex> backward;
+  std::vector<std::size_t> positions;
+  std::size_t last_affected = 0;
+};
@@ -15,6 +15,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+#include "check.h"
 #include "json.hpp"
 
 using namespace std;
@@ -61,18 +62,6 @@ ostream& operator << (ostream& os, const map<K, V>& m) {
   return os << "}";
 }
 
-inline void PrintBacktrace() {
-  void *array[10];
-  size_t size;
-
-  // get void*'s for all entries on the stack
-  size = backtrace(array, 10);
-
-  // print out all the frames to stderr
-  // fprintf(stderr, "Error: signal %d:\n", sig);
-  backtrace_symbols_fd(array, size, STDERR_FILENO);
-}
-
 template<class T, class U>
 void AssertEqual(const T& t, const U& u, const string& hint = {}) {
   if (!(t == u)) {
@@ -91,19 +80,17 @@ inline void Assert(bool b, const string& hint) {
 }
 
 
-#define ASSERT_EQUAL(x, y) {                          \
-  ostringstream __assert_equal_private_os;            \
-  __assert_equal_private_os                           \
-    << #x << " != " << #y << ", "                     \
-    << __FILE__ << ":" << __LINE__;                   \
-  AssertEqual(x, y, __assert_equal_private_os.str()); \
-}
-
-#define ASSERT(x) {                     \
-  ostringstream os;                     \
-  os << #x << " is false, "             \
-    << __FILE__ << ":" << __LINE__;     \
-  Assert(x, os.str());                  \
+#define ASSERT_EQUAL(x, y) {                                            \
+  const auto& __assert_equal_private_x = (x);                           \
+  const auto& __assert_equal_private_y = (y);                           \
+  if (!(__assert_equal_private_x == __assert_equal_private_y)) {        \
+    ostringstream __assert_equal_private_os;                            \
+    __assert_equal_private_os                                           \
+      << #x << " != " << #y << ", "                                     \
+      << __FILE__ << ":" << __LINE__;                                   \
+    AssertEqual(__assert_equal_private_x, __assert_equal_private_y,     \
+                __assert_equal_private_os.str());                       \
+  }                                                                     \
 }
 
 
@@ -0,0 +1,102 @@
+#include "wav_writer.h"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+
+namespace {
+
+const std::size_t kWavHeaderSize = 44;
+
+// WAV is little endian whatever the host is.
+template <typename T>
+void PutLE(std::byte* dst, T value) {
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    dst[i] = static_cast<std::byte>((static_cast<std::uint64_t>(value) >> (8 * i)) & 0xff);
+  }
+}
+
+}  // namespace
+
+WavWriter::WavWriter(const std::string& path, SampleFileFormat format, int sample_rate, int num_channels)
+    : file(path, std::ios::binary | std::ios::trunc)
+    , format(format)
+    , sample_rate(sample_rate)
+    , num_channels(num_channels) {
+  if (!file.is_open()) {
+    std::cout << "Can't open " << path << " for writing" << std::endl;
+    return;
+  }
+
+  if (format == SampleFileFormat::kWav) {
+    WriteHeader();
+  }
+}
+
+WavWriter::~WavWriter() {
+  Close();
+}
+
+void WavWriter::Write(const SampleType* samples, std::size_t n) {
+  static_assert(sizeof(SampleType) == 2);
+  std::array<std::byte, 4096> buffer;
+  for (size_t offset = 0; offset < n;) {
+    size_t count = std::min(n - offset, buffer.size() / sizeof(SampleType));
+    for (size_t i = 0; i < count; ++i) {
+      PutLE(buffer.data() + i * sizeof(SampleType), static_cast<std::uint16_t>(samples[offset + i]));
+    }
+    file.write(reinterpret_cast<const char*>(buffer.data()), count * sizeof(SampleType));
+    offset += count;
+  }
+  data_bytes += n * sizeof(SampleType);
+}
+
+void WavWriter::Close() {
+  if (!file.is_open()) {
+    return;
+  }
+
+  if (format == SampleFileFormat::kWav) {
+    file.seekp(0);
+    WriteHeader();
+  }
+  file.close();
+}
+
+void WavWriter::WriteHeader() {
+  // RIFF sizes are 32 bit, longer files are clamped and still play.
+  std::uint32_t data_size = static_cast<std::uint32_t>(std::min<std::uint64_t>(
+    data_bytes, std::numeric_limits<std::uint32_t>::max() - kWavHeaderSize));
+  std::uint16_t bits = 8 * sizeof(SampleType);
+  std::uint16_t block_align = num_channels * sizeof(SampleType);
+
+  std::array<std::byte, kWavHeaderSize> header{};
+  auto put_tag = [&header] (size_t offset, const char* tag) {
+    for (size_t i = 0; i < 4; ++i) {
+      header[offset + i] = static_cast<std::byte>(tag[i]);
+    }
+  };
+
+  put_tag(0, "RIFF");
+  PutLE<std::uint32_t>(&header[4], data_size + kWavHeaderSize - 8);
+  put_tag(8, "WAVE");
+  put_tag(12, "fmt ");
+  PutLE<std::uint32_t>(&header[16], 16);  // fmt chunk size
+  PutLE<std::uint16_t>(&header[20], 1);   // PCM
+  PutLE<std::uint16_t>(&header[22], num_channels);
+  PutLE<std::uint32_t>(&header[24], sample_rate);
+  PutLE<std::uint32_t>(&header[28], sample_rate * block_align);
+  PutLE<std::uint16_t>(&header[32], block_align);
+  PutLE<std::uint16_t>(&header[34], bits);
+  put_tag(36, "data");
+  PutLE<std::uint32_t>(&header[40], data_size);
+
+  file.write(reinterpret_cast<const char*>(header.data()), header.size());
+}
+
+SampleFileFormat FormatFromPath(const std::string& path) {
+  if (path.ends_with(".raw") || path.ends_with(".pcm")) {
+    return SampleFileFormat::kRaw;
+  }
+  return SampleFileFormat::kWav;
+}
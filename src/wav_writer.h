@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include "output.h"
+
+enum class SampleFileFormat {
+  kWav,  // 16 bit PCM RIFF/WAVE
+  kRaw   // Headerless 16 bit little endian samples
+};
+
+// Writes rendered samples to a file. The WAV header is written up front
+// and patched with the final sizes on Close().
+class WavWriter {
+ public:
+  WavWriter(const std::string& path, SampleFileFormat format, int sample_rate, int num_channels);
+  ~WavWriter();
+
+  WavWriter(const WavWriter&) = delete;
+  WavWriter& operator= (const WavWriter&) = delete;
+
+  bool IsOpen() const {
+    return file.is_open() && file.good();
+  }
+
+  // Samples of all channels, interleaved.
+  void Write(const SampleType* samples, std::size_t n);
+
+  void Close();
+
+  std::uint64_t NumBytes() const {
+    return data_bytes;
+  }
+
+ private:
+  void WriteHeader();
+
+  std::ofstream file;
+  SampleFileFormat format;
+  int sample_rate;
+  int num_channels;
+  std::uint64_t data_bytes = 0;
+};
+
+// Format from the file extension: ".raw" or ".pcm" is raw, anything else WAV.
+SampleFileFormat FormatFromPath(const std::string& path);
@@ -0,0 +1,70 @@
+// Converts patches between JSON and the binary format, both ways, without
+// creating any nodes. The output format follows the extension: binary for
+// .synp, JSON otherwise. The input format is detected.
+//
+// Usage: synth_convert <input> <output>
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "patch_file.h"
+
+#include "json.hpp"
+
+namespace {
+
+bool ReadJson(const std::string& path, nlohmann::json& j) {
+  std::ifstream f(path);
+  REQ_CHECK_EX(f.is_open(), "Can't open " << path);
+  try {
+    f >> j;
+  } catch (const nlohmann::json::exception& e) {
+    std::cout << "Can't parse " << path << ": " << e.what() << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool ReadBinary(const std::string& path, nlohmann::json& j) {
+  MappedFile file;
+  PatchView patch;
+  REQ_CHECK(file.Open(path));
+  REQ_CHECK(patch.Open(file.GetData(), file.GetSize()));
+  return PatchToJson(patch, j);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    std::cout << "Usage: synth_convert <input> <output>" << std::endl;
+    return 1;
+  }
+  const std::string input = argv[1];
+  const std::string output = argv[2];
+
+  nlohmann::json j;
+  bool ok = IsBinaryPatch(input) ? ReadBinary(input, j) : ReadJson(input, j);
+  if (!ok) {
+    return 1;
+  }
+
+  std::ofstream f(output, std::ios::binary);
+  if (!f.is_open()) {
+    std::cout << "Can't write " << output << std::endl;
+    return 1;
+  }
+
+  if (output.ends_with(kPatchExtension)) {
+    std::vector<std::uint8_t> patch;
+    if (!JsonToPatch(j, &patch)) {
+      return 1;
+    }
+    f.write(reinterpret_cast<const char*>(patch.data()), patch.size());
+  } else {
+    f << j;
+  }
+  return f.good() ? 0 : 1;
+}